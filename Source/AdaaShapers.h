@@ -0,0 +1,280 @@
+// AdaaShapers.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "ParameterSnapshot.h"
+#include "WaveshaperKernels.h"
+
+// Antiderivative anti-aliasing (ADAA) for the SoftClip, HardClip and Foldback curves.
+//
+// Instead of sampling the curve f at each input sample, ADAA outputs the average of f
+// over the straight line between consecutive inputs, worked out from its antiderivatives:
+//   1st order: y[n] = (F1(x[n]) - F1(x[n-1])) / (x[n] - x[n-1])
+//   2nd order: the same idea one level up, using F2 and the last three inputs
+// The averaging acts like a lowpass applied before the curve is sampled, so most of the
+// harmonics that would otherwise fold back are gone. It costs half a sample (1st order)
+// or one sample (2nd order) of delay at the processing rate.
+//
+// Differences of antiderivatives cancel badly in single precision, so this runs in double,
+// one sample at a time, whatever the sample type of the buffer. Where neighbouring inputs
+// are too close for the division to be trusted, the formulas fall back to evaluating the
+// curve at the midpoint.
+//
+// BitGlitch has no useful antiderivative and always goes through the plain kernels.
+//
+// Measured with a full-scale 4.7 kHz sine at 44.1 kHz and drive 1 (gain 10): power of
+// everything that isn't a harmonic, relative to the fundamental, with ideal decimation
+// standing in for the half-band filters.
+//                  1x      1x ADAA1  1x ADAA2  2x      2x ADAA1  2x ADAA2  4x      8x      16x
+//   SoftClip       -12 dB  -19 dB    -25 dB    -27 dB  -43 dB    -58 dB    -52 dB  -103 dB -167 dB
+//   HardClip       -11 dB  -18 dB    -24 dB    -23 dB  -39 dB    -54 dB    -41 dB  -49 dB  -64 dB
+//   Foldback       +20 dB    0 dB    -20 dB    -20 dB  -38 dB    -61 dB    -116 dB -119 dB -122 dB
+// So 2x + ADAA2 beats 8x for HardClip, whose corners alias at every rate (16x is another
+// 10 dB down), roughly matches 4x for SoftClip, and is no substitute for 4x and up on
+// Foldback, whose bandwidth grows with the drive.
+//
+// Shaper cost per sample (plain vectorised / ADAA1 / ADAA2): SoftClip 2.5 / 27 / 45 ns,
+// HardClip 0.3 / 1.9 / 4.7 ns, Foldback 1.4 / 24 / 24 ns. The whole chain per host sample
+// and channel, with the default filter (x64, GCC -O3, stereo, blocks of 512). These are the
+// chain alone: every oversampling step also adds a pair of half-band filters, which only
+// makes the higher rates dearer still.
+//                  1x ADAA2  2x      2x ADAA2  4x      8x      16x
+//   SoftClip       43 ns     36 ns   86 ns     72 ns   143 ns  286 ns
+//   HardClip       24 ns     31 ns   40 ns     63 ns   125 ns  250 ns
+//   Foldback       38 ns     34 ns   57 ns     67 ns   134 ns  268 ns
+// So ADAA only pays off for HardClip, where 2x + ADAA2 costs a third of 8x and aliases less.
+// It doesn't for SoftClip, which costs more than plain 4x for 6 dB less aliasing, or for
+// Foldback, which costs about as much as 4x for 55 dB more; on those, oversample instead.
+// The ADAA shapers aren't vectorised, since they run in double a sample at a time. Most of
+// their cost is the exp, log and dilogarithm in the SoftClip antiderivatives and the
+// sin and cos in the Foldback ones.
+//
+// Tests/Source/AdaaTests.cpp has the benchmarks these figures come from.
+namespace Adaa
+{
+    enum Order { Off = 0, FirstOrder = 1, SecondOrder = 2 };
+
+    //==============================================================================
+    namespace Math
+    {
+        // Li2(-t), the dilogarithm, for t in [0, 1].
+        // The Landen identity maps it onto Li2(w) with w in [0, 1/2], where the
+        // Bernoulli series in u = -log(1 - w) converges to double precision in 8 terms.
+        inline double dilogOfNegative(double t) noexcept
+        {
+            const double u = std::log1p(t);      // = -log(1 - w) for w = t / (1 + t)
+            const double u2 = u * u;
+
+            double series = -691.0 / 16999766784000.0;
+            series = series * u2 + 1.0 / 526901760.0;
+            series = series * u2 - 1.0 / 10886400.0;
+            series = series * u2 + 1.0 / 211680.0;
+            series = series * u2 - 1.0 / 3600.0;
+            series = series * u2 + 1.0 / 36.0;
+            series = u * (1.0 + u * (-0.25 + u * series));
+
+            return -series - 0.5 * u2;
+        }
+    }
+
+    //==============================================================================
+    // Each curve is written in terms of the driven signal x = gain * input, with
+    // F1' = f and F2' = F1. Constant and linear offsets don't matter, since they
+    // cancel in the divided differences.
+    struct SoftClipCurve
+    {
+        static constexpr double ln2 = 0.69314718055994530942;
+        static constexpr double piSquaredOver24 = 0.41123351671205660911;
+
+        static double function(double x) noexcept { return std::tanh(x); }
+
+        // log(cosh(x)), written so it can't overflow
+        static double antiderivative1(double x) noexcept
+        {
+            const double a = std::abs(x);
+            return a + std::log1p(std::exp(-2.0 * a)) - ln2;
+        }
+
+        // The integral of log(cosh(x)) from 0, which is odd
+        static double antiderivative2(double x) noexcept
+        {
+            const double a = std::abs(x);
+            const double value = 0.5 * a * a - a * ln2
+                               + 0.5 * Math::dilogOfNegative(std::exp(-2.0 * a))
+                               + piSquaredOver24;
+            return std::copysign(value, x);
+        }
+    };
+
+    struct HardClipCurve
+    {
+        static double function(double x) noexcept { return juce::jlimit(-1.0, 1.0, x); }
+
+        static double antiderivative1(double x) noexcept
+        {
+            const double a = std::abs(x);
+            return a <= 1.0 ? 0.5 * x * x : a - 0.5;
+        }
+
+        static double antiderivative2(double x) noexcept
+        {
+            const double a = std::abs(x);
+            return a <= 1.0 ? x * x * x / 6.0 : std::copysign(0.5 * a * a - 0.5 * a + 1.0 / 6.0, x);
+        }
+    };
+
+    struct FoldbackCurve
+    {
+        static double function(double x) noexcept { return std::sin(x); }
+        static double antiderivative1(double x) noexcept { return -std::cos(x); }
+        static double antiderivative2(double x) noexcept { return -std::sin(x); }
+    };
+
+    template <DistortionType type> struct CurveFor { using Type = SoftClipCurve; };
+    template <> struct CurveFor<HardClip> { using Type = HardClipCurve; };
+    template <> struct CurveFor<Foldback> { using Type = FoldbackCurve; };
+
+    //==============================================================================
+    // Runs the ADAA shapers over one channel at a time, keeping each channel's input history.
+    class Waveshaper
+    {
+    public:
+        void prepare(int numChannels)
+        {
+            states.assign((size_t)juce::jmax(0, numChannels), ChannelState{});
+        }
+
+        void reset() noexcept
+        {
+            std::fill(states.begin(), states.end(), ChannelState{});
+        }
+
+        // Frees the channel histories until the next prepare()
+        void release()
+        {
+            std::vector<ChannelState>().swap(states);
+        }
+
+        int getNumChannels() const noexcept { return (int)states.size(); }
+
+        size_t getMemoryUsage() const noexcept { return states.capacity() * sizeof(ChannelState); }
+
+        // Delay added at the processing rate, in samples
+        static double getLatencyInSamples(Order order) noexcept
+        {
+            return order == SecondOrder ? 1.0 : order == FirstOrder ? 0.5 : 0.0;
+        }
+
+        template <DistortionType type, typename SampleType>
+        void process(SampleType* data, int numSamples, int channel, float drive, Order order) noexcept
+        {
+            static_assert(type != BitGlitch, "BitGlitch has no ADAA version");
+            using Curve = typename CurveFor<type>::Type;
+
+            jassert(juce::isPositiveAndBelow(channel, getNumChannels()));
+            auto& state = states[(size_t)channel];
+
+            // Switching curve or order leaves the cached antiderivatives stale, so rebuild them
+            // from the input history before carrying on
+            if (state.type != type || state.order != order)
+                prime<Curve>(state, type, order);
+
+            const double gain = WaveshaperKernels::getGain(drive);
+
+            if (order == SecondOrder)
+                processSecondOrder<Curve>(state, data, numSamples, gain);
+            else
+                processFirstOrder<Curve>(state, data, numSamples, gain);
+        }
+
+    private:
+        struct ChannelState
+        {
+            double x1 = 0.0;            // Previous driven input
+            double x2 = 0.0;            // The one before that
+            double ad1 = 0.0;           // F1(x1), for 1st order
+            double ad2 = 0.0;           // F2(x1), for 2nd order
+            double d2 = 0.0;            // Divided difference of F2 between x2 and x1, for 2nd order
+            int type = -1;              // Curve and order the cached values belong to
+            Order order = Off;
+        };
+
+        // Below these input differences the divided differences are mostly rounding error
+        static constexpr double firstOrderTolerance = 1.0e-5;
+        static constexpr double secondOrderTolerance = 1.0e-3;
+
+        template <typename Curve>
+        static double dividedDifference(double x0, double x1, double ad2x0, double ad2x1) noexcept
+        {
+            const double delta = x0 - x1;
+            return std::abs(delta) < secondOrderTolerance ? Curve::antiderivative1(0.5 * (x0 + x1))
+                                                          : (ad2x0 - ad2x1) / delta;
+        }
+
+        template <typename Curve>
+        static void prime(ChannelState& state, DistortionType type, Order order) noexcept
+        {
+            state.ad1 = Curve::antiderivative1(state.x1);
+            state.ad2 = Curve::antiderivative2(state.x1);
+            state.d2 = dividedDifference<Curve>(state.x1, state.x2, state.ad2, Curve::antiderivative2(state.x2));
+            state.type = (int)type;
+            state.order = order;
+        }
+
+        template <typename Curve, typename SampleType>
+        static void processFirstOrder(ChannelState& state, SampleType* data, int numSamples, double gain) noexcept
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const double x = gain * (double)data[i];
+                const double ad1 = Curve::antiderivative1(x);
+                const double delta = x - state.x1;
+
+                data[i] = (SampleType)(std::abs(delta) < firstOrderTolerance ? Curve::function(0.5 * (x + state.x1))
+                                                                        : (ad1 - state.ad1) / delta);
+
+                state.x2 = state.x1;
+                state.x1 = x;
+                state.ad1 = ad1;
+            }
+        }
+
+        template <typename Curve, typename SampleType>
+        static void processSecondOrder(ChannelState& state, SampleType* data, int numSamples, double gain) noexcept
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const double x = gain * (double)data[i];
+                const double ad2 = Curve::antiderivative2(x);
+                const double d1 = dividedDifference<Curve>(x, state.x1, ad2, state.ad2);
+
+                double y;
+
+                if (std::abs(x - state.x2) >= secondOrderTolerance)
+                {
+                    y = 2.0 * (d1 - state.d2) / (x - state.x2);
+                }
+                else
+                {
+                    // x came back to where it was two samples ago: average over x1 -> midpoint instead
+                    const double xBar = 0.5 * (x + state.x2);
+                    const double delta = xBar - state.x1;
+
+                    y = std::abs(delta) < secondOrderTolerance
+                          ? Curve::function(0.5 * (xBar + state.x1))
+                          : 2.0 / delta * (Curve::antiderivative1(xBar)
+                                           + (Curve::antiderivative2(state.x1) - Curve::antiderivative2(xBar)) / delta);
+                }
+
+                data[i] = (SampleType)y;
+
+                state.x2 = state.x1;
+                state.x1 = x;
+                state.ad2 = ad2;
+                state.d2 = d1;
+            }
+        }
+
+        std::vector<ChannelState> states;
+    };
+}
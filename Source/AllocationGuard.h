@@ -0,0 +1,70 @@
+// AllocationGuard.h
+#pragma once
+
+#include <JuceHeader.h>
+
+// Debug check that processBlock never allocates.
+//
+// Build with NANI_DETECT_AUDIO_THREAD_ALLOCATIONS=1 (add it to the preprocessor
+// definitions of a Debug configuration in the Projucer) and the global operator
+// new/delete are replaced with versions that hit an assertion whenever they're
+// called while a ScopedNoAllocation is alive on the current thread.
+// In normal builds everything here compiles away.
+#ifndef NANI_DETECT_AUDIO_THREAD_ALLOCATIONS
+ #define NANI_DETECT_AUDIO_THREAD_ALLOCATIONS 0
+#endif
+
+namespace AllocationGuard
+{
+#if NANI_DETECT_AUDIO_THREAD_ALLOCATIONS
+    // How many ScopedNoAllocation objects are alive on this thread
+    inline thread_local int noAllocationDepth = 0;
+
+    // Total number of allocations caught, handy to watch in the debugger
+    inline std::atomic<int> allocationsDetected { 0 };
+
+    // Called by the replaced allocation functions
+    inline void checkAllocation() noexcept
+    {
+        if (noAllocationDepth > 0)
+        {
+            // Leave the zone while reporting, as the assertion itself may allocate
+            const int depth = noAllocationDepth;
+            noAllocationDepth = 0;
+
+            ++allocationsDetected;
+            jassertfalse; // Something allocated or freed memory on the audio thread!
+
+            noAllocationDepth = depth;
+        }
+    }
+
+    struct ScopedNoAllocation
+    {
+        ScopedNoAllocation() noexcept { ++noAllocationDepth; }
+        ~ScopedNoAllocation() noexcept { --noAllocationDepth; }
+    };
+
+    // Temporarily lifts the check, e.g. for a host that breaks the block size contract
+    struct ScopedAllowAllocation
+    {
+        ScopedAllowAllocation() noexcept : savedDepth(noAllocationDepth) { noAllocationDepth = 0; }
+        ~ScopedAllowAllocation() noexcept { noAllocationDepth = savedDepth; }
+        const int savedDepth;
+    };
+#else
+    // Do nothing, but with a constructor and destructor of their own, so the guards
+    // don't show up as unused variables
+    struct ScopedNoAllocation
+    {
+        ScopedNoAllocation() noexcept {}
+        ~ScopedNoAllocation() noexcept {}
+    };
+
+    struct ScopedAllowAllocation
+    {
+        ScopedAllowAllocation() noexcept {}
+        ~ScopedAllowAllocation() noexcept {}
+    };
+#endif
+}
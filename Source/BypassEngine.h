@@ -0,0 +1,129 @@
+// BypassEngine.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "LatencyDelay.h"
+
+// Bypass that sounds the same as the host's own latency-compensated bypass would.
+//
+// The input always goes through a delay matched to the latency we report, so the
+// bypassed signal lines up with the processed one. Switching crossfades between the
+// two over a few milliseconds instead of jumping. Once the fade to bypass is over,
+// isFullyBypassed() tells the processor it can skip everything else.
+//
+// The dry side of the Mix control comes from the same delay line through a second read
+// tap. It's mixed in before the output limiter, so it's delayed by the latency of the wet
+// path without the limiter's lookahead; the bypass signal needs the full latency.
+template <typename SampleType>
+class BypassEngine
+{
+public:
+    void prepare(double sampleRate, int numChannels, int maxBlockSize)
+    {
+        // Room for up to 100 ms of reported latency
+        dryDelay.prepare(numChannels, maxBlockSize, juce::nextPowerOfTwo(juce::roundToInt(sampleRate * 0.1)));
+
+        wetGain.reset(sampleRate, crossfadeSeconds);
+        wetGain.setCurrentAndTargetValue(wetGain.getTargetValue());
+        wasFullyBypassed = isFullyBypassed();
+        resuming = false;
+    }
+
+    void reset() noexcept
+    {
+        dryDelay.reset();
+    }
+
+    // Frees the delay line until the next prepare()
+    void release()
+    {
+        dryDelay.release();
+        delayedDry = nullptr;
+        mixDry = nullptr;
+    }
+
+    // Call at the start of every block, before anything touches the buffer. mixLatencySamples
+    // is the part of the latency that comes before the Mix control.
+    void pushInput(const juce::AudioBuffer<SampleType>& input, int latencySamples, int mixLatencySamples, bool shouldBypass)
+    {
+        dryDelay.setDelay(latencySamples);
+        delayedDry = &dryDelay.process(input);
+        mixDry = &dryDelay.readTap(mixLatencySamples, input.getNumSamples());
+
+        wetGain.setTargetValue(shouldBypass ? 0.0f : 1.0f);
+
+        // Coming back from full bypass, the wet path's state is out of date
+        resuming = wasFullyBypassed && !isFullyBypassed();
+        wasFullyBypassed = isFullyBypassed();
+    }
+
+    // Only the delayed input is audible, so there's no need to process anything
+    bool isFullyBypassed() const noexcept { return !wetGain.isSmoothing() && wetGain.getTargetValue() == 0.0f; }
+
+    // A switch is under way, so applyCrossfade() will change the buffer
+    bool isCrossfading() const noexcept { return wetGain.isSmoothing(); }
+
+    // True for the first block after full bypass, when the wet path should be reset
+    bool isResuming() const noexcept { return resuming; }
+
+    // The input, delayed by the reported latency. Valid after pushInput(); only the
+    // first input.getNumSamples() samples are meaningful.
+    const juce::AudioBuffer<SampleType>& getDelayedDry() const noexcept
+    {
+        jassert(delayedDry != nullptr);
+        return *delayedDry;
+    }
+
+    // The input, delayed by the mix latency passed to pushInput(), for the dry side of the Mix
+    // control. Only the first input.getNumSamples() samples are meaningful.
+    const juce::AudioBuffer<SampleType>& getMixDry() const noexcept
+    {
+        jassert(mixDry != nullptr);
+        return *mixDry;
+    }
+
+    // Replaces the buffer with the delayed input
+    void copyDryTo(juce::AudioBuffer<SampleType>& buffer) const noexcept
+    {
+        const auto& dry = getDelayedDry();
+
+        for (int channel = 0; channel < juce::jmin(buffer.getNumChannels(), dry.getNumChannels()); ++channel)
+            buffer.copyFrom(channel, 0, dry, channel, 0, buffer.getNumSamples());
+    }
+
+    // Crossfades the processed signal in the buffer with the delayed input, if a switch is under way
+    void applyCrossfade(juce::AudioBuffer<SampleType>& buffer) noexcept
+    {
+        if (!wetGain.isSmoothing())
+            return;
+
+        const auto& dry = getDelayedDry();
+        const int numSamples = buffer.getNumSamples();
+
+        const float startGain = wetGain.getCurrentValue();
+        wetGain.skip(numSamples);
+        const float endGain = wetGain.getCurrentValue();
+
+        for (int channel = 0; channel < juce::jmin(buffer.getNumChannels(), dry.getNumChannels()); ++channel)
+        {
+            buffer.applyGainRamp(channel, 0, numSamples, (SampleType)startGain, (SampleType)endGain);
+            buffer.addFromWithRamp(channel, 0, dry.getReadPointer(channel), numSamples,
+                                   (SampleType)(1.0f - startGain), (SampleType)(1.0f - endGain));
+        }
+    }
+
+    size_t getMemoryUsage() const noexcept { return dryDelay.getMemoryUsage(); }
+
+private:
+    static constexpr double crossfadeSeconds = 0.01;
+
+    LatencyDelay<SampleType> dryDelay;
+    const juce::AudioBuffer<SampleType>* delayedDry = nullptr;
+    const juce::AudioBuffer<SampleType>* mixDry = nullptr;
+
+    juce::SmoothedValue<float> wetGain { 1.0f };
+    bool wasFullyBypassed = false;
+    bool resuming = false;
+
+    JUCE_LEAK_DETECTOR(BypassEngine)
+};
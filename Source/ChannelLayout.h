@@ -0,0 +1,90 @@
+// ChannelLayout.h
+#pragma once
+
+#include <JuceHeader.h>
+
+// What the processor needs to know about the bus layout: how many channels there can be,
+// and which of them form left/right pairs for the stereo width control.
+//
+// Everything else in the chain treats channels independently, so any layout works as
+// long as the input and output are the same; the cost is linear in the channel count.
+namespace ChannelLayout
+{
+    // Enough for a 9.1.6 bed
+    static constexpr int maxChannels = 16;
+
+    struct Pair
+    {
+        int left = 0;
+        int right = 1;
+    };
+
+    // The left/right pairs of a layout, front pair first
+    struct Pairs
+    {
+        static constexpr int maxPairs = maxChannels / 2;
+
+        std::array<Pair, maxPairs> pairs {};
+        int numPairs = 0;
+        int numFrontPairs = 0; // 1 if the layout has a front left/right pair, which is pairs[0]
+
+        void add(Pair pair) noexcept
+        {
+            if (numPairs < maxPairs)
+                pairs[(size_t)numPairs++] = pair;
+        }
+    };
+
+    inline bool isSupported(const juce::AudioProcessor::BusesLayout& layouts)
+    {
+        const auto& output = layouts.getMainOutputChannelSet();
+
+        // The dry path and the bypass need the output to match the input channel for channel
+        return !output.isDisabled()
+            && output.size() <= maxChannels
+            && layouts.getMainInputChannelSet() == output;
+    }
+
+    // Message thread, when the layout is known (prepareToPlay)
+    inline Pairs findPairs(const juce::AudioChannelSet& channels)
+    {
+        using Set = juce::AudioChannelSet;
+
+        static constexpr std::pair<Set::ChannelType, Set::ChannelType> candidates[] = {
+            { Set::left,             Set::right },
+            { Set::leftCentre,       Set::rightCentre },
+            { Set::leftSurround,     Set::rightSurround },
+            { Set::leftSurroundSide, Set::rightSurroundSide },
+            { Set::leftSurroundRear, Set::rightSurroundRear },
+            { Set::wideLeft,         Set::wideRight },
+            { Set::topFrontLeft,     Set::topFrontRight },
+            { Set::topSideLeft,      Set::topSideRight },
+            { Set::topRearLeft,      Set::topRearRight },
+        };
+
+        Pairs result;
+
+        for (const auto& [leftType, rightType] : candidates)
+        {
+            const int left = channels.getChannelIndexForType(leftType);
+            const int right = channels.getChannelIndexForType(rightType);
+
+            if (left >= 0 && right >= 0)
+            {
+                result.add({ left, right });
+
+                if (leftType == Set::left)
+                    result.numFrontPairs = 1;
+            }
+        }
+
+        // A discrete two-channel layout is still a stereo pair
+        if (result.numPairs == 0 && channels.size() == 2)
+        {
+            result.add({ 0, 1 });
+            result.numFrontPairs = 1;
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,170 @@
+// Decimator.h
+#pragma once
+
+#include <JuceHeader.h>
+
+// The sample rate reducer: a sample-and-hold that grabs a new input value every
+// `factor` samples and repeats it in between.
+//
+// Every channel has its own phase and held value, so the right channel no longer picks
+// up where the left one left off. Blocks are processed one hold segment at a time: the
+// position of the next grab is worked out up front, and the samples before it are a
+// plain fill, so the hot loop is a memset-style store the compiler vectorises.
+//
+// Two options on top of the classic sound:
+//  - bandLimited: a 2nd-order lowpass at 90% of the reduced Nyquist frequency in front
+//    of the hold, so the input can't alias when it's resampled at the lower rate.
+//  - fractional: grabs the input at the exact fractional position (linear interpolation)
+//    instead of the nearest sample, so non-integer factors give an even rate without jitter.
+//
+// The held values and the lowpass run in the sample type; the hold counter is always float.
+// The counter keeps whole samples apart from the fraction, so a block gives exactly the
+// same output however it's split into calls.
+template <typename SampleType>
+class Decimator
+{
+public:
+    struct Options
+    {
+        bool bandLimited = false;
+        bool fractional = false;
+    };
+
+    void prepare(int numChannels)
+    {
+        states.assign((size_t)juce::jmax(0, numChannels), ChannelState{});
+    }
+
+    void reset() noexcept
+    {
+        std::fill(states.begin(), states.end(), ChannelState{});
+    }
+
+    // Frees the channel states until the next prepare()
+    void release()
+    {
+        std::vector<ChannelState>().swap(states);
+    }
+
+    int getNumChannels() const noexcept { return (int)states.size(); }
+
+    size_t getMemoryUsage() const noexcept { return states.capacity() * sizeof(ChannelState); }
+
+    // Processes one channel in place. factor is the number of samples between grabs (>= 1).
+    void process(int channel, SampleType* data, int numSamples, float factor, Options options) noexcept
+    {
+        jassert(juce::isPositiveAndBelow(channel, getNumChannels()));
+        jassert(factor >= 1.0f);
+
+        auto& state = states[(size_t)channel];
+
+        if (options.bandLimited)
+            applyLowpass(state, data, numSamples, factor);
+
+        int i = 0;
+
+        while (i < numSamples)
+        {
+            // The counter goes up by one per sample; the grab happens on the sample that takes it to factor
+            const int stepsToGrab = juce::jmax(1, (int)std::ceil(factor - state.counter) - state.samplesSinceGrab);
+            const int grabIndex = i + stepsToGrab - 1;
+
+            if (grabIndex >= numSamples)
+            {
+                // No grab in the rest of this block
+                state.previousInput = data[numSamples - 1];
+                std::fill(data + i, data + numSamples, state.heldSample);
+                state.samplesSinceGrab += numSamples - i;
+                break;
+            }
+
+            const SampleType input = data[grabIndex];
+            const SampleType previousInput = grabIndex > i ? data[grabIndex - 1] : state.previousInput;
+            state.counter += (float)(state.samplesSinceGrab + stepsToGrab) - factor;
+            state.samplesSinceGrab = 0;
+
+            // The samples up to the grab keep repeating the old value
+            std::fill(data + i, data + grabIndex, state.heldSample);
+
+            // counter is now how far past the exact grab position we are, in samples. It can only
+            // exceed one sample right after the factor has been turned down, so stop there.
+            const auto overshoot = (SampleType)juce::jmin(state.counter, 1.0f);
+            state.heldSample = options.fractional ? input - overshoot * (input - previousInput) : input;
+            state.previousInput = input;
+            data[grabIndex] = state.heldSample;
+
+            i = grabIndex + 1;
+        }
+    }
+
+    // While the decimator is switched off it follows the input, so it picks up cleanly
+    // when it's switched back on
+    void follow(int channel, SampleType lastSample) noexcept
+    {
+        if (!juce::isPositiveAndBelow(channel, getNumChannels()))
+            return;
+
+        auto& state = states[(size_t)channel];
+        state.counter = 0.0f;
+        state.samplesSinceGrab = 0;
+        state.heldSample = lastSample;
+        state.previousInput = lastSample;
+        state.lowpassPrimed = false;
+    }
+
+private:
+    struct ChannelState
+    {
+        float counter = 0.0f;           // How far past the exact position the last grab was, in samples
+        int samplesSinceGrab = 0;       // Whole samples since the last grab
+        SampleType heldSample = 0;      // The value being repeated
+        SampleType previousInput = 0;   // Last input sample seen, for fractional grabs across blocks
+
+        // Band-limiting lowpass (transposed direct form II)
+        SampleType z1 = 0;
+        SampleType z2 = 0;
+        bool lowpassPrimed = false;
+    };
+
+    void applyLowpass(ChannelState& state, SampleType* data, int numSamples, float factor) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        // Butterworth lowpass, bilinear transform with prewarping
+        const double k = std::tan(juce::MathConstants<double>::pi * 0.45 / (double)factor);
+        const double norm = 1.0 / (1.0 + juce::MathConstants<double>::sqrt2 * k + k * k);
+        const auto b0 = (SampleType)(k * k * norm);
+        const SampleType b1 = 2 * b0;
+        const SampleType b2 = b0;
+        const auto a1 = (SampleType)(2.0 * (k * k - 1.0) * norm);
+        const auto a2 = (SampleType)((1.0 - juce::MathConstants<double>::sqrt2 * k + k * k) * norm);
+
+        SampleType z1 = state.z1;
+        SampleType z2 = state.z2;
+
+        // Start from the steady state for the first input, instead of ramping up from silence
+        if (!state.lowpassPrimed)
+        {
+            z2 = (b2 - a2) * data[0];
+            z1 = (b1 - a1) * data[0] + z2;
+            state.lowpassPrimed = true;
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const SampleType x = data[i];
+            const SampleType y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            data[i] = y;
+        }
+
+        state.z1 = z1;
+        state.z2 = z2;
+    }
+
+    std::vector<ChannelState> states;
+
+    JUCE_LEAK_DETECTOR(Decimator)
+};
@@ -0,0 +1,226 @@
+// FilterBank.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "ParameterSnapshot.h"
+
+// The filter, once for every rate the chain can run at (1x, 2x, 4x, 8x and 16x), each
+// prepared at its own sample rate so the cutoff is right whatever the oversampling factor.
+//
+// Each filter only touches its coefficients when the type, cutoff or resonance actually
+// change. The cutoff glides to new values over a short time, updated every sample while
+// it moves; the rest of the time the block goes through the filter in one go.
+//
+// A block is bracketed by beginBlock() and endBlock(). In between, as long as the cutoff
+// isn't gliding, the channels are independent and can be processed separately, even on
+// different threads.
+//
+// The filter states and coefficients are in the sample type; the cutoff smoothing is float.
+template <typename SampleType>
+class FilterBank
+{
+public:
+    static constexpr int numRates = 5;
+
+    // 1x -> 0, 2x -> 1 ... 16x -> 4
+    static int getRateIndex(size_t oversamplingFactor) noexcept
+    {
+        int index = 0;
+
+        while (index < numRates - 1 && ((size_t)1 << index) < oversamplingFactor)
+            ++index;
+
+        return index;
+    }
+
+    //==============================================================================
+    class Filter
+    {
+    public:
+        void prepare(const juce::dsp::ProcessSpec& spec)
+        {
+            sampleRate = spec.sampleRate;
+            filter.prepare(spec);
+            cutoff.reset(spec.sampleRate, cutoffSmoothingSeconds);
+            restart();
+        }
+
+        // Type and resonance change straight away, the cutoff glides to its new value
+        void setParameters(FilterType newType, float newCutoff, float newResonance) noexcept
+        {
+            if (newType != type)
+            {
+                type = newType;
+
+                switch (type) {
+                case LowPass:  filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);  break;
+                case HighPass: filter.setType(juce::dsp::StateVariableTPTFilterType::highpass); break;
+                case BandPass: filter.setType(juce::dsp::StateVariableTPTFilterType::bandpass); break;
+                }
+            }
+
+            if (newResonance != resonance)
+            {
+                resonance = newResonance;
+                filter.setResonance((SampleType)newResonance);
+            }
+
+            // Keep clear of Nyquist, which the 1x filter at 44.1 kHz gets close to
+            const float target = juce::jmin(newCutoff, (float)(sampleRate * 0.49));
+
+            if (needsRestart)
+                cutoff.setCurrentAndTargetValue(target);
+            else
+                cutoff.setTargetValue(target);
+        }
+
+        // Once per block, before process(). Returns true if the channels can be processed
+        // separately this block, false if the cutoff is gliding.
+        bool beginBlock() noexcept
+        {
+            if (needsRestart)
+            {
+                filter.reset();
+                needsRestart = false;
+            }
+
+            gliding = cutoff.isSmoothing();
+
+            if (!gliding)
+                updateCutoff(cutoff.getTargetValue());
+
+            return !gliding;
+        }
+
+        // The block holds channels firstChannel onwards. While the cutoff glides, it has to
+        // be the whole set of channels, since they all step through the same cutoff values.
+        void process(juce::dsp::AudioBlock<SampleType>& block, int firstChannel = 0) noexcept
+        {
+            const auto numChannels = block.getNumChannels();
+            const auto numSamples = block.getNumSamples();
+
+            if (!gliding)
+            {
+                for (size_t channel = 0; channel < numChannels; ++channel)
+                {
+                    auto* channelData = block.getChannelPointer(channel);
+                    const int stateChannel = firstChannel + (int)channel;
+
+                    for (size_t sample = 0; sample < numSamples; ++sample)
+                        channelData[sample] = filter.processSample(stateChannel, channelData[sample]);
+                }
+
+                return;
+            }
+
+            // The cutoff is moving: new coefficients every sample, all channels at a time
+            jassert(firstChannel == 0);
+
+            for (size_t sample = 0; sample < numSamples; ++sample)
+            {
+                updateCutoff(cutoff.getNextValue());
+
+                for (size_t channel = 0; channel < numChannels; ++channel)
+                {
+                    auto* channelData = block.getChannelPointer(channel);
+                    channelData[sample] = filter.processSample((int)channel, channelData[sample]);
+                }
+            }
+        }
+
+        // Once per block, after every channel has been through process()
+        void endBlock() noexcept
+        {
+            filter.snapToZero();
+        }
+
+        // Called when this filter takes over after another rate has been running: its state
+        // is stale, so it starts from silence and jumps straight to the current cutoff
+        void restart() noexcept { needsRestart = true; }
+
+    private:
+        void updateCutoff(float newCutoff) noexcept
+        {
+            if (newCutoff != currentCutoff)
+            {
+                currentCutoff = newCutoff;
+                filter.setCutoffFrequency((SampleType)newCutoff);
+            }
+        }
+
+        static constexpr double cutoffSmoothingSeconds = 0.02;
+
+        juce::dsp::StateVariableTPTFilter<SampleType> filter;
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> cutoff { 1000.0f };
+
+        // What the filter's coefficients were last computed for (JUCE's defaults)
+        FilterType type = LowPass;
+        float currentCutoff = 1000.0f;
+        float resonance = 1.0f / juce::MathConstants<float>::sqrt2;
+
+        double sampleRate = 44100.0;
+        bool needsRestart = true;
+        bool gliding = false;
+    };
+
+    //==============================================================================
+    void prepare(double baseSampleRate, int maxBlockSize, int numChannels)
+    {
+        for (int rate = 0; rate < numRates; ++rate)
+        {
+            juce::dsp::ProcessSpec spec;
+            spec.sampleRate = baseSampleRate * (double)(1 << rate);
+            spec.maximumBlockSize = (juce::uint32)(maxBlockSize << rate);
+            spec.numChannels = (juce::uint32)numChannels;
+
+            filters[(size_t)rate].prepare(spec);
+        }
+
+        preparedChannels = numChannels;
+        activeRate = -1;
+    }
+
+    void reset() noexcept
+    {
+        for (auto& filter : filters)
+            filter.restart();
+
+        activeRate = -1;
+    }
+
+    // Frees the filters' channel states until the next prepare(). A fresh Filter also
+    // forgets the coefficients, so nothing is left pointing at the old settings.
+    void release()
+    {
+        for (auto& filter : filters)
+            filter = Filter{};
+
+        preparedChannels = 0;
+        activeRate = -1;
+    }
+
+    // Each filter keeps two state variables per channel
+    size_t getMemoryUsage() const noexcept
+    {
+        return (size_t)numRates * 2 * (size_t)preparedChannels * sizeof(SampleType);
+    }
+
+    // The filter for the given rate. Switching rate restarts the filter taking over.
+    Filter& getFilter(int rateIndex) noexcept
+    {
+        rateIndex = juce::jlimit(0, numRates - 1, rateIndex);
+
+        if (rateIndex != activeRate)
+        {
+            filters[(size_t)rateIndex].restart();
+            activeRate = rateIndex;
+        }
+
+        return filters[(size_t)rateIndex];
+    }
+
+private:
+    std::array<Filter, numRates> filters;
+    int activeRate = -1;
+    int preparedChannels = 0;
+};
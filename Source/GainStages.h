@@ -0,0 +1,361 @@
+// GainStages.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdFloat.h"
+#include "MeterTransport.h"
+#include "ChannelLayout.h"
+#include "ParameterRamps.h"
+
+// The cheap per-sample work either side of the distortion, fused into one pass each.
+//
+// The pre-stage meters the input, applies the input gain and the stereo width; the
+// post-stage blends in the dry signal, applies the output gain and (when nothing runs
+// after it) meters the output. Done as separate buffer operations that's eight trips
+// through the block; fused, every sample is loaded and stored once per stage.
+//
+// Metering gives the peak, the sum of squares and the clipped sample count of each
+// channel (a Metering::ChannelReading), all kept in registers until the end of the block.
+//
+// Like the waveshaper kernels, each step is written once over Simd::Float1 and
+// Simd::Float4, so the leftover samples at the end of a block get exactly the same maths.
+// On the double precision path the same steps run over Simd::Double1, one sample at a
+// time; the readings they produce are float either way.
+//
+// Measured on a stereo 512-sample block (x64, SSE2, GCC 12 -O3), against the same work
+// done as separate passes over the buffer, one per step, the way it was done before:
+//   pre-stage  (input meter, input gain, width):       about 1350 ns -> 320 ns
+//   post-stage (mix, output gain, output meter):       about 1450 ns -> 400 ns
+// With the width at 100% the pre-stage skips the mid/side maths, as before.
+// In double precision, one sample at a time, the same two stages take about 1200 ns and
+// 1550 ns, against about 2550 ns each as separate passes. The benchmarks in
+// Tests/Source/GainStagesTests.cpp produce these figures, and its test checks the stages
+// against the separate passes.
+//
+// The gains, the width and the mix come in as ParameterRamps::Ramp, so a moving parameter
+// glides across the block instead of jumping at its start. Each stage is compiled twice:
+// when none of its ramps is moving it runs the code above unchanged, with the values
+// worked out once per block; otherwise the ramps are evaluated four samples at a time
+// alongside the audio. While something is moving, the two stages on the same stereo block
+// take about 600 ns and 1100 ns.
+namespace GainStages
+{
+    namespace detail
+    {
+        inline float maxElement(Simd::Float1 x) noexcept { return x.value; }
+        inline float sumElements(Simd::Float1 x) noexcept { return x.value; }
+        inline float maxElement(Simd::Double1 x) noexcept { return (float)x.value; }
+        inline float sumElements(Simd::Double1 x) noexcept { return (float)x.value; }
+
+       #if NANI_SIMD_AVAILABLE
+        inline float maxElement(Simd::Float4 x) noexcept
+        {
+            float values[Simd::Float4::size];
+            x.store(values);
+            return juce::jmax(values[0], values[1], values[2], values[3]);
+        }
+
+        inline float sumElements(Simd::Float4 x) noexcept
+        {
+            float values[Simd::Float4::size];
+            x.store(values);
+            return (values[0] + values[1]) + (values[2] + values[3]);
+        }
+       #endif
+
+        // The one-sample vector type for each sample type
+        template <typename SampleType>
+        using Scalar = std::conditional_t<std::is_same_v<SampleType, double>, Simd::Double1, Simd::Float1>;
+
+        // Runs step(Vec, sampleIndex) over a block, four floats at a time where possible
+        template <typename SampleType, typename Step>
+        inline void forEachVector(int numSamples, Step&& step) noexcept
+        {
+            int i = 0;
+
+           #if NANI_SIMD_AVAILABLE
+            if constexpr (std::is_same_v<SampleType, float>)
+                for (; i + Simd::Float4::size <= numSamples; i += Simd::Float4::size)
+                    step(Simd::Float4{}, i);
+           #endif
+
+            // Leftover samples go through the same maths one at a time
+            for (; i < numSamples; ++i)
+                step(Scalar<SampleType>{}, i);
+        }
+
+        // A ramp's values for the samples from i on, or its one value when it isn't moving
+        template <bool ramped, typename Vec>
+        inline Vec valuesAt(ParameterRamps::Ramp ramp, int i) noexcept
+        {
+            if constexpr (ramped)
+                return ramp.at<Vec>(i);
+            else
+                return Vec::expand(ramp.end);
+        }
+
+        // Running peak, sum of squares and clip count, for either vector type. Clipped
+        // samples are counted in floats, which stay exact far beyond any block size.
+        template <typename Vec>
+        struct Accumulator
+        {
+            Vec peak = Vec::expand(0.0f);
+            Vec sumOfSquares = Vec::expand(0.0f);
+            Vec numClipped = Vec::expand(0.0f);
+
+            void add(Vec x) noexcept
+            {
+                const auto magnitude = Vec::abs(x);
+                const auto one = Vec::expand(1.0f);
+
+                peak = Vec::max(peak, magnitude);
+                sumOfSquares = sumOfSquares + x * x;
+                numClipped = numClipped + Vec::select(Vec::lessThan(magnitude, one), Vec::expand(0.0f), one);
+            }
+        };
+
+        template <typename SampleType>
+        struct Meter
+        {
+           #if NANI_SIMD_AVAILABLE
+            Accumulator<Simd::Float4> wide;
+           #endif
+            Accumulator<Scalar<SampleType>> narrow;
+
+            template <typename Vec>
+            void add(Vec x) noexcept
+            {
+               #if NANI_SIMD_AVAILABLE
+                if constexpr (std::is_same_v<Vec, Simd::Float4>)
+                    wide.add(x);
+                else
+               #endif
+                    narrow.add(x);
+            }
+
+            Metering::ChannelReading getReading() const noexcept
+            {
+                Metering::ChannelReading reading;
+                reading.peak = maxElement(narrow.peak);
+                reading.sumOfSquares = sumElements(narrow.sumOfSquares);
+                float numClipped = sumElements(narrow.numClipped);
+
+               #if NANI_SIMD_AVAILABLE
+                reading.peak = juce::jmax(reading.peak, maxElement(wide.peak));
+                reading.sumOfSquares += sumElements(wide.sumOfSquares);
+                numClipped += sumElements(wide.numClipped);
+               #endif
+
+                reading.numClipped = (int)numClipped;
+                return reading;
+            }
+        };
+
+        //==============================================================================
+        // Measures one channel without changing it
+        template <typename SampleType>
+        inline Metering::ChannelReading measureChannel(const SampleType* data, int numSamples) noexcept
+        {
+            Meter<SampleType> meter;
+
+            forEachVector<SampleType>(numSamples, [&](auto vec, int i)
+            {
+                using Vec = decltype(vec);
+                meter.add(Vec::load(data + i));
+            });
+
+            return meter.getReading();
+        }
+
+        // Input metering and gain on one channel
+        template <bool ramped, typename SampleType>
+        inline Metering::ChannelReading preStageChannel(SampleType* data, int numSamples, ParameterRamps::Ramp gain) noexcept
+        {
+            Meter<SampleType> meter;
+
+            forEachVector<SampleType>(numSamples, [&](auto vec, int i)
+            {
+                using Vec = decltype(vec);
+                const auto x = Vec::load(data + i);
+                meter.add(x);
+                (x * valuesAt<ramped, Vec>(gain, i)).store(data + i);
+            });
+
+            return meter.getReading();
+        }
+
+        // Input metering, gain and mid/side width on a stereo pair. The gain is folded into the
+        // mid and side scaling, so it's the same two multiplies as the width on its own.
+        template <bool ramped, typename SampleType>
+        inline void preStageStereo(SampleType* left, SampleType* right, int numSamples,
+                                   ParameterRamps::Ramp gain, ParameterRamps::Ramp width,
+                                   Metering::ChannelReading& leftReading, Metering::ChannelReading& rightReading) noexcept
+        {
+            Meter<SampleType> meterL, meterR;
+            const float midGain = 0.5f * gain.end;
+            const float sideGain = 0.5f * gain.end * width.end;
+
+            forEachVector<SampleType>(numSamples, [&](auto vec, int i)
+            {
+                using Vec = decltype(vec);
+                const auto l = Vec::load(left + i);
+                const auto r = Vec::load(right + i);
+                meterL.add(l);
+                meterR.add(r);
+
+                auto midScale = Vec::expand(midGain);
+                auto sideScale = Vec::expand(sideGain);
+
+                if constexpr (ramped)
+                {
+                    midScale = Vec::expand(0.5f) * gain.at<Vec>(i);
+                    sideScale = midScale * width.at<Vec>(i);
+                }
+
+                const auto mid = (l + r) * midScale;
+                const auto side = (r - l) * sideScale;
+                (mid - side).store(left + i);
+                (mid + side).store(right + i);
+            });
+
+            leftReading = meterL.getReading();
+            rightReading = meterR.getReading();
+        }
+
+        // wet = (wet * mix + dry * (1 - mix)) * gain, or just wet * gain without the dry
+        // signal, optionally metering the result
+        template <bool withDry, bool withMeter, bool ramped, typename SampleType>
+        inline Metering::ChannelReading postStageChannel(SampleType* wet, const SampleType* dry, int numSamples,
+                                                         ParameterRamps::Ramp mix, ParameterRamps::Ramp gain) noexcept
+        {
+            Meter<SampleType> meter;
+            const float wetGain = (withDry ? mix.end : 1.0f) * gain.end;
+            const float dryGain = (1.0f - mix.end) * gain.end;
+
+            forEachVector<SampleType>(numSamples, [&](auto vec, int i)
+            {
+                using Vec = decltype(vec);
+                auto wetScale = Vec::expand(wetGain);
+                auto dryScale = Vec::expand(dryGain);
+
+                if constexpr (ramped)
+                {
+                    const auto g = gain.at<Vec>(i);
+                    const auto m = withDry ? mix.at<Vec>(i) : Vec::expand(1.0f);
+                    wetScale = m * g;
+                    dryScale = (Vec::expand(1.0f) - m) * g;
+                }
+
+                auto y = Vec::load(wet + i) * wetScale;
+
+                if constexpr (withDry)
+                    y = y + Vec::load(dry + i) * dryScale;
+
+                if constexpr (withMeter)
+                    meter.add(y);
+
+                y.store(wet + i);
+            });
+
+            return meter.getReading();
+        }
+
+        template <bool ramped, typename SampleType>
+        inline Metering::ChannelReading postStageChannel(SampleType* wet, const SampleType* dry, int numSamples,
+                                                         ParameterRamps::Ramp mix, ParameterRamps::Ramp gain,
+                                                         bool mixed, bool metered) noexcept
+        {
+            if (mixed)
+                return metered ? postStageChannel<true, true, ramped>(wet, dry, numSamples, mix, gain)
+                               : postStageChannel<true, false, ramped>(wet, dry, numSamples, mix, gain);
+
+            return metered ? postStageChannel<false, true, ramped>(wet, dry, numSamples, mix, gain)
+                           : postStageChannel<false, false, ramped>(wet, dry, numSamples, mix, gain);
+        }
+    }
+
+    //==============================================================================
+    // Meters every channel without changing anything. readings must have room for
+    // numReadings values; channels past that aren't metered.
+    template <typename SampleType>
+    inline void measure(const SampleType* const* channels, int numChannels, int numSamples,
+                        Metering::ChannelReading* readings, int numReadings) noexcept
+    {
+        for (int channel = 0; channel < juce::jmin(numChannels, numReadings); ++channel)
+            readings[channel] = detail::measureChannel(channels[channel], numSamples);
+    }
+
+    // Meters every channel, then applies the input gain, and the stereo width on the given
+    // left/right pairs. Channels past numReadings are processed but not metered.
+    template <typename SampleType>
+    inline void processPreStage(SampleType* const* channels, int numChannels, int numSamples,
+                                const ParameterRamps::Ramp& inputGain, ParameterRamps::Ramp width,
+                                const ChannelLayout::Pair* pairs, int numPairs,
+                                Metering::ChannelReading* readings, int numReadings) noexcept
+    {
+        jassert(numChannels <= ChannelLayout::maxChannels);
+
+        auto store = [&](int channel, const Metering::ChannelReading& reading)
+        {
+            if (channel < numReadings)
+                readings[channel] = reading;
+        };
+
+        // Bit n is set once channel n has been done as part of a pair
+        uint32_t done = 0;
+        const bool widthRamped = width.isMoving() || inputGain.isMoving();
+
+        if (width.isMoving() || width.end != 1.0f)
+        {
+            for (int i = 0; i < numPairs; ++i)
+            {
+                const auto pair = pairs[i];
+
+                if (!juce::isPositiveAndBelow(pair.left, numChannels) || !juce::isPositiveAndBelow(pair.right, numChannels))
+                    continue;
+
+                Metering::ChannelReading left, right;
+
+                if (widthRamped)
+                    detail::preStageStereo<true>(channels[pair.left], channels[pair.right], numSamples, inputGain, width, left, right);
+                else
+                    detail::preStageStereo<false>(channels[pair.left], channels[pair.right], numSamples, inputGain, width, left, right);
+
+                store(pair.left, left);
+                store(pair.right, right);
+
+                done |= (1u << pair.left) | (1u << pair.right);
+            }
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            if ((done & (1u << channel)) == 0)
+                store(channel, inputGain.isMoving() ? detail::preStageChannel<true>(channels[channel], numSamples, inputGain)
+                                                    : detail::preStageChannel<false>(channels[channel], numSamples, inputGain));
+    }
+
+    // Blends the wet channels with the dry ones by mix and applies the output gain. Channels
+    // without a dry counterpart just get the gain. If readings isn't null, every output
+    // channel (up to numReadings) is metered on the way.
+    template <typename SampleType>
+    inline void processPostStage(SampleType* const* wet, int numChannels, const SampleType* const* dry, int numDryChannels,
+                                 int numSamples, ParameterRamps::Ramp mix, const ParameterRamps::Ramp& outputGain,
+                                 Metering::ChannelReading* readings, int numReadings) noexcept
+    {
+        const bool withDry = mix.isMoving() || mix.end < 1.0f;
+        const bool ramped = mix.isMoving() || outputGain.isMoving();
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const bool mixed = withDry && channel < numDryChannels;
+            const bool metered = readings != nullptr && channel < numReadings;
+            const SampleType* dryChannel = mixed ? dry[channel] : nullptr;
+
+            const auto reading = ramped ? detail::postStageChannel<true>(wet[channel], dryChannel, numSamples, mix, outputGain, mixed, metered)
+                                        : detail::postStageChannel<false>(wet[channel], dryChannel, numSamples, mix, outputGain, mixed, metered);
+
+            if (metered)
+                readings[channel] = reading;
+        }
+    }
+}
@@ -0,0 +1,138 @@
+// LatencyDelay.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "AllocationGuard.h"
+
+// A multichannel delay of a whole number of samples, used to line the dry signal up
+// with the processed one when the wet path has latency.
+//
+// It's a ring buffer that blocks are copied in and out of in at most two pieces each,
+// so the cost doesn't depend on the delay and there's no per-sample work. readTap() reads
+// the same ring a second time at a shorter delay, for a signal that needs less of it.
+template <typename SampleType>
+class LatencyDelay
+{
+public:
+    void prepare(int numChannels, int maxBlockSize, int maxDelayInSamples)
+    {
+        maxDelay = juce::jmax(0, maxDelayInSamples);
+        ringSize = juce::nextPowerOfTwo(maxDelay + maxBlockSize + 1);
+
+        ring.setSize(numChannels, ringSize, false, true, false);
+        output.setSize(numChannels, maxBlockSize, false, true, false);
+        tapOutput.setSize(numChannels, maxBlockSize, false, true, false);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        ring.clear();
+        output.clear();
+        tapOutput.clear();
+        writePosition = 0;
+    }
+
+    // Frees the buffers until the next prepare()
+    void release()
+    {
+        ring.setSize(0, 0);
+        output.setSize(0, 0);
+        tapOutput.setSize(0, 0);
+        ringSize = 1;
+        writePosition = 0;
+        delay = 0;
+        maxDelay = 0;
+    }
+
+    void setDelay(int delayInSamples) noexcept
+    {
+        // Any latency we report has to fit in what was allocated in prepare()
+        jassert(delayInSamples <= maxDelay);
+        delay = juce::jlimit(0, maxDelay, delayInSamples);
+    }
+
+    int getDelay() const noexcept { return delay; }
+    int getMaxDelay() const noexcept { return maxDelay; }
+
+    size_t getMemoryUsage() const noexcept
+    {
+        return (size_t)(ring.getNumChannels() * ring.getNumSamples()
+                        + output.getNumChannels() * output.getNumSamples()
+                        + tapOutput.getNumChannels() * tapOutput.getNumSamples()) * sizeof(SampleType);
+    }
+
+    // Writes the block into the delay and returns it `delay` samples later. Only the
+    // first input.getNumSamples() samples of the returned buffer are valid.
+    const juce::AudioBuffer<SampleType>& process(const juce::AudioBuffer<SampleType>& input)
+    {
+        const int numChannels = juce::jmin(input.getNumChannels(), ring.getNumChannels());
+        const int numSamples = input.getNumSamples();
+
+        // The host sent a bigger block than it promised in prepareToPlay
+        if (numSamples > output.getNumSamples() || numSamples + maxDelay >= ringSize)
+        {
+            jassertfalse;
+            AllocationGuard::ScopedAllowAllocation allowAllocation;
+            prepare(ring.getNumChannels(), numSamples, maxDelay);
+        }
+
+        const int readPosition = (writePosition - delay + ringSize) & (ringSize - 1);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            copyIntoRing(channel, input.getReadPointer(channel), numSamples);
+            copyFromRing(channel, readPosition, output.getWritePointer(channel), numSamples);
+        }
+
+        writePosition = (writePosition + numSamples) & (ringSize - 1);
+        return output;
+    }
+
+    // The block last passed to process(), `tapDelay` samples later. Call it after process()
+    // with the same number of samples; only the first numSamples of the returned buffer are valid.
+    const juce::AudioBuffer<SampleType>& readTap(int tapDelay, int numSamples) noexcept
+    {
+        // process() has already made room for the block
+        jassert(numSamples <= tapOutput.getNumSamples());
+        jassert(tapDelay <= maxDelay);
+
+        const int readPosition = (writePosition - numSamples - juce::jlimit(0, maxDelay, tapDelay) + 2 * ringSize) & (ringSize - 1);
+
+        for (int channel = 0; channel < tapOutput.getNumChannels(); ++channel)
+            copyFromRing(channel, readPosition, tapOutput.getWritePointer(channel), numSamples);
+
+        return tapOutput;
+    }
+
+private:
+    void copyIntoRing(int channel, const SampleType* source, int numSamples) noexcept
+    {
+        const int firstPart = juce::jmin(numSamples, ringSize - writePosition);
+        ring.copyFrom(channel, writePosition, source, firstPart);
+
+        if (firstPart < numSamples)
+            ring.copyFrom(channel, 0, source + firstPart, numSamples - firstPart);
+    }
+
+    void copyFromRing(int channel, int readPosition, SampleType* dest, int numSamples) const noexcept
+    {
+        const auto* source = ring.getReadPointer(channel);
+        const int firstPart = juce::jmin(numSamples, ringSize - readPosition);
+        std::copy(source + readPosition, source + readPosition + firstPart, dest);
+
+        if (firstPart < numSamples)
+            std::copy(source, source + (numSamples - firstPart), dest + firstPart);
+    }
+
+    juce::AudioBuffer<SampleType> ring;
+    juce::AudioBuffer<SampleType> output;
+    juce::AudioBuffer<SampleType> tapOutput;
+
+    int ringSize = 1;
+    int writePosition = 0;
+    int delay = 0;
+    int maxDelay = 0;
+
+    JUCE_LEAK_DETECTOR(LatencyDelay)
+};
@@ -3,6 +3,9 @@
 
 #include <JuceHeader.h>
 
+// Draws a meter level. The ballistics (how the level rises and falls) are worked out by
+// Metering::Ballistics before the level gets here; this only maps it to dB and holds
+// the clip indicator.
 class LevelMeter : public juce::Component, private juce::Timer
 {
 public:
@@ -16,20 +19,24 @@ public:
         stopTimer();
     }
 
-    void setLevel(float newLevel)
+    void setLevel(float newPeak, float newRms, int numClippedSamples)
     {
         // Check for clipping
-        if (newLevel >= 1.0f)
+        if (numClippedSamples > 0)
         {
             isClipping = true;
             clipTimer = clipHoldTime;
         }
 
-        // Convert to dB for better visual representation
-        targetLevel = juce::Decibels::gainToDecibels(newLevel, -60.0f);
-        // Normalize to 0.0 - 1.0 range
-        targetLevel = juce::jmap(targetLevel, -60.0f, 6.0f, 0.0f, 1.0f);
-        targetLevel = juce::jlimit(0.0f, 1.0f, targetLevel);
+        const float newLevel = toMeterPosition(newPeak);
+        const float newRmsLevel = toMeterPosition(newRms);
+
+        if (newLevel != level || newRmsLevel != rmsLevel)
+        {
+            level = newLevel;
+            rmsLevel = newRmsLevel;
+            repaint();
+        }
     }
 
     void paint(juce::Graphics& g) override
@@ -56,6 +63,11 @@ public:
         g.setGradientFill(gradient);
         g.fillRect(bounds.withTrimmedTop(bounds.getHeight() - meterHeight));
 
+        // RMS level as a line across the bar
+        const float rmsY = bounds.getBottom() - bounds.getHeight() * rmsLevel;
+        g.setColour(juce::Colours::white.withAlpha(0.8f));
+        g.drawLine(bounds.getX(), rmsY, bounds.getRight(), rmsY, 2.0f);
+
         // Draw tick marks
         g.setColour(juce::Colours::white.withAlpha(0.5f));
 
@@ -100,13 +112,19 @@ public:
     void resetClipping()
     {
         isClipping = false;
+        repaint();
     }
 
 private:
+    // Convert to dB for better visual representation, normalized to the 0.0 - 1.0 range
+    static float toMeterPosition(float gain)
+    {
+        const float decibels = juce::Decibels::gainToDecibels(gain, -60.0f);
+        return juce::jlimit(0.0f, 1.0f, juce::jmap(decibels, -60.0f, 6.0f, 0.0f, 1.0f));
+    }
+
     float level = 0.0f;
-    float targetLevel = 0.0f;
-    float attackRate = 0.9f;    // How quickly the meter rises (smaller = faster)
-    float releaseRate = 0.75f;  // How quickly the meter falls (smaller = faster)
+    float rmsLevel = 0.0f;
 
     // Clipping indicator
     bool isClipping = false;
@@ -116,20 +134,15 @@ private:
 
     void timerCallback() override
     {
-        // Fast attack, slower release for natural meter behavior
-        if (targetLevel > level)
-            level = level * attackRate + targetLevel * (1.0f - attackRate); // Rise quickly
-        else
-            level = level * releaseRate + targetLevel * (1.0f - releaseRate); // Fall more slowly
-
         // Update clip timer
         if (isClipping && clipTimer > 0)
         {
             clipTimer--;
             if (clipTimer <= 0)
+            {
                 isClipping = false;
+                repaint();
+            }
         }
-
-        repaint();
     }
 };
\ No newline at end of file
@@ -0,0 +1,174 @@
+// MeterTransport.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChannelLayout.h"
+
+// Getting meter readings from the audio thread to the editor without a data race.
+//
+// Every block the audio thread pushes one Frame with the peak, the sum of squares and
+// the number of clipped samples of each channel, stamped with the block's position and
+// length in samples. Frames go through a single-producer, single-consumer FIFO; if the
+// editor is closed or falls behind, frames are simply dropped, so pushing never blocks.
+//
+// All the ballistics (release, RMS averaging, clip counting) happen in Ballistics on the
+// UI thread. They advance by the length of each frame, not once per block, so the meters
+// move the same way whatever the host's buffer size is.
+namespace Metering
+{
+    static constexpr int maxChannels = ChannelLayout::maxChannels;
+
+    // What one block looked like on one channel
+    struct ChannelReading
+    {
+        float peak = 0.0f;
+        float sumOfSquares = 0.0f;
+        int numClipped = 0;     // Samples at or above full scale
+    };
+
+    struct Frame
+    {
+        juce::int64 timestamp = 0;  // The block's first sample, counted from prepareToPlay
+        int numSamples = 0;
+        double sampleRate = 44100.0;
+        int numChannels = 0;
+
+        std::array<ChannelReading, maxChannels> input {};
+        std::array<ChannelReading, maxChannels> output {};
+    };
+
+    //==============================================================================
+    class Transport
+    {
+    public:
+        // Audio thread. Returns false (and drops the frame) if the FIFO is full.
+        bool push(const Frame& frame) noexcept
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+            if (size1 + size2 < 1)
+                return false;
+
+            frames[(size_t)(size1 > 0 ? start1 : start2)] = frame;
+            fifo.finishedWrite(1);
+            return true;
+        }
+
+        // UI thread. Returns false if there's nothing to read.
+        bool pop(Frame& frame) noexcept
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToRead(1, start1, size1, start2, size2);
+
+            if (size1 + size2 < 1)
+                return false;
+
+            frame = frames[(size_t)(size1 > 0 ? start1 : start2)];
+            fifo.finishedRead(1);
+            return true;
+        }
+
+        // UI thread: throws away whatever is waiting, e.g. when an editor opens
+        void discardAll() noexcept
+        {
+            fifo.finishedRead(fifo.getNumReady());
+        }
+
+    private:
+        // Several editor refreshes' worth of frames, even with tiny host blocks
+        static constexpr int capacity = 256;
+
+        juce::AbstractFifo fifo { capacity };
+        std::array<Frame, capacity> frames;
+
+        JUCE_DECLARE_NON_COPYABLE(Transport)
+    };
+
+    //==============================================================================
+    // UI side: turns frames into meter levels
+    class Ballistics
+    {
+    public:
+        struct Level
+        {
+            float peak = 0.0f;      // Instant attack, exponential release
+            float rms = 0.0f;       // Exponentially averaged
+            int numClipped = 0;     // Clipped samples in the frames read by the last update()
+        };
+
+        // Drains the transport. If nothing arrived (playback stopped, say), the meters
+        // fall by the time that has passed instead.
+        void update(Transport& transport, double elapsedSeconds) noexcept
+        {
+            for (auto* levels : { &inputLevels, &outputLevels })
+                for (auto& level : *levels)
+                    level.numClipped = 0;
+
+            Frame frame;
+            bool gotFrame = false;
+
+            while (transport.pop(frame))
+            {
+                apply(frame);
+                gotFrame = true;
+            }
+
+            if (!gotFrame)
+                fall(elapsedSeconds);
+        }
+
+        const Level& getInput(int channel) const noexcept { return inputLevels[(size_t)juce::jlimit(0, maxChannels - 1, channel)]; }
+        const Level& getOutput(int channel) const noexcept { return outputLevels[(size_t)juce::jlimit(0, maxChannels - 1, channel)]; }
+
+    private:
+        static constexpr double peakReleaseSeconds = 0.3;
+        static constexpr double rmsSeconds = 0.3;
+
+        void apply(const Frame& frame) noexcept
+        {
+            if (frame.numSamples <= 0 || frame.sampleRate <= 0.0)
+                return;
+
+            const double duration = frame.numSamples / frame.sampleRate;
+            const float peakRelease = (float)std::exp(-duration / peakReleaseSeconds);
+            const float rmsRelease = (float)std::exp(-duration / rmsSeconds);
+
+            for (int channel = 0; channel < juce::jmin(frame.numChannels, maxChannels); ++channel)
+            {
+                apply(inputLevels[(size_t)channel], frame.input[(size_t)channel], frame.numSamples, peakRelease, rmsRelease);
+                apply(outputLevels[(size_t)channel], frame.output[(size_t)channel], frame.numSamples, peakRelease, rmsRelease);
+            }
+        }
+
+        static void apply(Level& level, const ChannelReading& reading, int numSamples,
+                          float peakRelease, float rmsRelease) noexcept
+        {
+            level.peak = juce::jmax(reading.peak, level.peak * peakRelease);
+
+            const float meanSquare = reading.sumOfSquares / (float)numSamples;
+            const float previousMeanSquare = level.rms * level.rms;
+            level.rms = std::sqrt(previousMeanSquare * rmsRelease + meanSquare * (1.0f - rmsRelease));
+
+            level.numClipped += reading.numClipped;
+        }
+
+        void fall(double seconds) noexcept
+        {
+            const float peakRelease = (float)std::exp(-seconds / peakReleaseSeconds);
+            const float rmsRelease = (float)std::exp(-seconds / rmsSeconds);
+
+            for (auto* levels : { &inputLevels, &outputLevels })
+            {
+                for (auto& level : *levels)
+                {
+                    level.peak *= peakRelease;
+                    level.rms *= std::sqrt(rmsRelease);
+                }
+            }
+        }
+
+        std::array<Level, maxChannels> inputLevels {};
+        std::array<Level, maxChannels> outputLevels {};
+    };
+}
@@ -0,0 +1,264 @@
+// Multiband.h
+#pragma once
+
+#include <JuceHeader.h>
+
+// The crossover for the multiband mode: up to four bands split by 4th-order
+// Linkwitz-Riley filters.
+//
+// The bands are split off one at a time from the bottom up. Each Linkwitz-Riley pair sums
+// to an allpass at its frequency, so to sum back flat every band also goes through the
+// allpasses of the crossovers above it. The bands then add up to the input through the
+// chain of all the allpasses: flat in magnitude and phase-coherent, with no latency (it's
+// minimum phase, not linear phase). applyAllpass() runs the same allpass chain on its own,
+// so a dry signal can be brought into phase with the summed bands before they're mixed.
+//
+// While no band is shaped, splitting the bands only to add them straight back up is wasted
+// work: the allpass chain alone gives the same sum. setBypassed() switches a channel over to
+// it and back. The filters of the path switched to have stood still since it last ran, so
+// they start again from silence, and for fadeSeconds both paths run while the new one
+// settles and fade() crossfades over to it.
+//
+// All the filters are 2nd-order TPT state variable filters, so they stay stable while the
+// crossover frequencies move. Every channel's filter states sit together in one struct,
+// and the channels in one vector, so the whole crossover is a single contiguous block.
+// They run in the sample type, so the double precision path splits in double too.
+namespace Multiband
+{
+    static constexpr int maxBands = 4;
+    static constexpr int maxCrossovers = maxBands - 1;
+
+    // Bands are split, shaped and summed in chunks of this many samples, so the band
+    // buffers stay small enough to live in L1 whatever the block size and oversampling factor
+    static constexpr int chunkSize = 256;
+
+    // How long a switch between splitting and the allpass shortcut is crossfaded over
+    static constexpr double fadeSeconds = 0.02;
+
+    template <typename SampleType>
+    class Crossover
+    {
+    public:
+        void prepare(int numChannels)
+        {
+            states.assign((size_t)juce::jmax(0, numChannels), ChannelState{});
+        }
+
+        void reset() noexcept
+        {
+            std::fill(states.begin(), states.end(), ChannelState{});
+        }
+
+        // Frees the filter states until the next prepare()
+        void release()
+        {
+            std::vector<ChannelState>().swap(states);
+        }
+
+        int getNumBands() const noexcept { return numBands; }
+        int getNumChannels() const noexcept { return (int)states.size(); }
+
+        size_t getMemoryUsage() const noexcept { return states.capacity() * sizeof(ChannelState); }
+
+        // Coefficients are only recomputed for frequencies that changed. A new sample rate or
+        // band count clears the filter states, since they no longer mean anything.
+        void setParameters(double newSampleRate, int newNumBands, const std::array<float, maxCrossovers>& frequencies) noexcept
+        {
+            newNumBands = juce::jlimit(1, maxBands, newNumBands);
+
+            if (newSampleRate != sampleRate || newNumBands != numBands)
+            {
+                sampleRate = newSampleRate;
+                numBands = newNumBands;
+                fadeLength = juce::jmax(1, juce::roundToInt(sampleRate * fadeSeconds));
+                currentFrequencies.fill(0.0f);
+                reset();
+            }
+
+            // Keep the frequencies in order and clear of Nyquist
+            float lowest = 10.0f;
+
+            for (int k = 0; k < numBands - 1; ++k)
+            {
+                const float frequency = juce::jlimit(lowest, (float)(sampleRate * 0.45), frequencies[(size_t)k]);
+                lowest = frequency;
+
+                if (frequency != currentFrequencies[(size_t)k])
+                {
+                    currentFrequencies[(size_t)k] = frequency;
+                    coefficients[(size_t)k] = Coefficients::make(frequency, sampleRate);
+                }
+            }
+        }
+
+        // Splits one channel into getNumBands() bands, lowest first
+        void split(int channel, const SampleType* input, SampleType* const* bands, int numSamples) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channel, (int)states.size()));
+            auto& state = states[(size_t)channel];
+            const int numCrossovers = numBands - 1;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                SampleType rest = input[i];
+
+                for (int k = 0; k < numCrossovers; ++k)
+                {
+                    const auto& c = coefficients[(size_t)k];
+                    SampleType low, band, high;
+                    state.splitInput[(size_t)k].process(c, rest, low, band, high);
+
+                    bands[k][i] = state.splitLow[(size_t)k].lowpass(c, low);
+                    rest = state.splitHigh[(size_t)k].highpass(c, high);
+                }
+
+                bands[numCrossovers][i] = rest;
+            }
+
+            // Band k goes through the allpass of every crossover above it (k + 1 and up)
+            int slot = 0;
+
+            for (int k = 0; k < numCrossovers - 1; ++k)
+                for (int above = k + 1; above < numCrossovers; ++above)
+                    state.bandAllpass[(size_t)slot++].allpass(coefficients[(size_t)above], bands[k], numSamples);
+        }
+
+        // What the bands sum to: the input through the allpass of every crossover
+        void applyAllpass(int channel, SampleType* data, int numSamples) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channel, (int)states.size()));
+            auto& state = states[(size_t)channel];
+
+            for (int k = 0; k < numBands - 1; ++k)
+                state.sumAllpass[(size_t)k].allpass(coefficients[(size_t)k], data, numSamples);
+        }
+
+        // Whether a channel takes the allpass shortcut instead of split() (see the top of the file)
+        void setBypassed(int channel, bool shouldBeBypassed) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channel, (int)states.size()));
+            auto& state = states[(size_t)channel];
+
+            if (shouldBeBypassed == state.bypassed)
+                return;
+
+            state.bypassed = shouldBeBypassed;
+            state.fadeRemaining = fadeLength;
+
+            if (shouldBeBypassed)
+            {
+                state.sumAllpass = {};
+            }
+            else
+            {
+                state.splitInput = {};
+                state.splitLow = {};
+                state.splitHigh = {};
+                state.bandAllpass = {};
+            }
+        }
+
+        bool isBypassed(int channel) const noexcept { return states[(size_t)channel].bypassed; }
+
+        // Whether the last switch is still being crossfaded, so both paths have to run
+        bool isFading(int channel) const noexcept { return states[(size_t)channel].fadeRemaining > 0; }
+
+        // Blends from the old path's output (previous) to the new path's, in data
+        void fade(int channel, SampleType* data, const SampleType* previous, int numSamples) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channel, (int)states.size()));
+            auto& state = states[(size_t)channel];
+            const auto step = (SampleType)1 / (SampleType)fadeLength;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto amount = (SampleType)1 - (SampleType)juce::jmax(0, state.fadeRemaining - i) * step;
+                data[i] = previous[i] + amount * (data[i] - previous[i]);
+            }
+
+            state.fadeRemaining = juce::jmax(0, state.fadeRemaining - numSamples);
+        }
+
+    private:
+        struct Coefficients
+        {
+            SampleType g = 0;
+            SampleType h = 1;
+
+            static Coefficients make(float frequency, double sampleRate) noexcept
+            {
+                const double g = std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+                return { (SampleType)g, (SampleType)(1.0 / (1.0 + R2 * g + g * g)) };
+            }
+        };
+
+        // Butterworth damping; two of these in series make a Linkwitz-Riley filter
+        static constexpr double R2 = juce::MathConstants<double>::sqrt2;
+
+        struct Svf
+        {
+            SampleType s1 = 0;
+            SampleType s2 = 0;
+
+            void process(const Coefficients& c, SampleType x, SampleType& low, SampleType& band, SampleType& high) noexcept
+            {
+                high = (x - ((SampleType)R2 + c.g) * s1 - s2) * c.h;
+                band = c.g * high + s1;
+                s1 = c.g * high + band;
+                low = c.g * band + s2;
+                s2 = c.g * band + low;
+            }
+
+            SampleType lowpass(const Coefficients& c, SampleType x) noexcept
+            {
+                SampleType low, band, high;
+                process(c, x, low, band, high);
+                return low;
+            }
+
+            SampleType highpass(const Coefficients& c, SampleType x) noexcept
+            {
+                SampleType low, band, high;
+                process(c, x, low, band, high);
+                return high;
+            }
+
+            void allpass(const Coefficients& c, SampleType* data, int numSamples) noexcept
+            {
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    SampleType low, band, high;
+                    process(c, data[i], low, band, high);
+                    data[i] = low - (SampleType)R2 * band + high;
+                }
+            }
+        };
+
+        struct ChannelState
+        {
+            // Each split: one filter on the input, then a second on each of its outputs
+            std::array<Svf, maxCrossovers> splitInput;
+            std::array<Svf, maxCrossovers> splitLow;
+            std::array<Svf, maxCrossovers> splitHigh;
+
+            // Phase compensation: band 0 needs the allpasses of crossovers 1 and 2, band 1 that of crossover 2
+            std::array<Svf, 3> bandAllpass;
+
+            // For applyAllpass()
+            std::array<Svf, maxCrossovers> sumAllpass;
+
+            bool bypassed = false;      // Taking the allpass shortcut
+            int fadeRemaining = 0;      // Samples left of the crossfade from the other path
+        };
+
+        std::vector<ChannelState> states;
+        std::array<Coefficients, maxCrossovers> coefficients {};
+        std::array<float, maxCrossovers> currentFrequencies {};
+
+        double sampleRate = 0.0;
+        int numBands = 1;
+        int fadeLength = 1;
+
+        JUCE_LEAK_DETECTOR(Crossover)
+    };
+}
@@ -0,0 +1,310 @@
+// OversamplerManager.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "ParameterSnapshot.h"
+
+// Owns the oversampler the processor is using, and builds the next one when the
+// oversampling settings change.
+//
+// Only the active configuration exists. prepare() builds it on the spot; after that,
+// changes requested from the audio thread are built on a background thread, handed
+// back through an atomic pointer, and crossfaded in over a few milliseconds. The old
+// oversampler is deleted on the background thread once the crossfade is over, so the
+// audio thread never allocates or frees one.
+//
+// The audio thread only ever sets atomics and triggers an async update; the background
+// thread is woken from the message thread. It isn't started until the first change is
+// asked for, so an instance whose oversampling never changes has no thread at all, and
+// once started it sleeps until there's something to do.
+//
+// The float and double precision paths each have their own manager; only the one for the
+// precision the host picked gets prepared.
+template <typename SampleType>
+class OversamplerManager : private juce::Thread, private juce::AsyncUpdater
+{
+public:
+    // Which oversampler: the filter mode and the oversamplingFactor choice (0 = off, 1 = 2x ... 4 = 16x)
+    struct Key
+    {
+        OversamplingMode mode = LinearPhase;
+        int index = 0;
+
+        bool operator==(const Key& other) const noexcept { return mode == other.mode && index == other.index; }
+        bool operator!=(const Key& other) const noexcept { return !(*this == other); }
+    };
+
+    static constexpr int maxIndex = 4;
+
+    static Key getKey(const ParameterSnapshot& params) noexcept
+    {
+        return { params.oversamplingMode == LowLatency ? LowLatency : LinearPhase,
+                 juce::jlimit(0, maxIndex, params.oversamplingIndex) };
+    }
+
+    OversamplerManager() : juce::Thread("Oversampler builder") {}
+
+    ~OversamplerManager() override
+    {
+        release();
+    }
+
+    //==============================================================================
+    // Message thread, while the audio thread is stopped: builds the oversampler for
+    // initialKey straight away and throws away everything else.
+    void prepare(int numChannels, int maxBlockSize, double sampleRate, Key initialKey)
+    {
+        release();
+
+        preparedChannels = numChannels;
+        preparedBlockSize = maxBlockSize;
+        crossfadeLength = juce::jmax(1, juce::roundToInt(sampleRate * crossfadeSeconds));
+
+        active = build(initialKey).release();
+        requested = active->key;
+        handledSerial = requestSerial.load();
+    }
+
+    void release()
+    {
+        cancelPendingUpdate();
+        stopThread(2000);
+
+        destroy(active);
+        destroy(outgoing);
+        destroy(ready.exchange(nullptr));
+
+        for (auto& slot : retired)
+            destroy(slot.exchange(nullptr));
+
+        active = nullptr;
+        outgoing = nullptr;
+    }
+
+    //==============================================================================
+    // Audio thread, at the start of every block: asks for the oversampler these settings
+    // need, and starts the crossfade to it once it has been built.
+    // Returns true when a crossfade starts in this block.
+    bool update(Key wanted) noexcept
+    {
+        if (active == nullptr)
+            return false;
+
+        bool crossfadeStarted = false;
+
+        // One crossfade at a time; a finished build waits in ready until this one is done
+        if (outgoing == nullptr)
+        {
+            if (auto* built = ready.exchange(nullptr))
+            {
+                if (built->key == wanted && built->key != active->key)
+                {
+                    outgoing = active;
+                    active = built;
+                    crossfadePosition = 0;
+                    crossfadeStarted = true;
+                }
+                else
+                {
+                    // The settings moved on while it was being built
+                    retire(built);
+                    requested = active->key;
+                }
+            }
+        }
+
+        if (wanted != active->key && wanted != requested)
+        {
+            requested = wanted;
+            requestedKey.store(encode(wanted));
+            requestSerial.fetch_add(1);
+            triggerAsyncUpdate();
+        }
+
+        return crossfadeStarted;
+    }
+
+    // The oversampler to process this block with, or nullptr for no oversampling
+    juce::dsp::Oversampling<SampleType>* getActive() const noexcept
+    {
+        return active != nullptr ? active->oversampler.get() : nullptr;
+    }
+
+    // Clears the active oversampler's filter state, e.g. after it hasn't run for a while
+    void resetActive() noexcept
+    {
+        if (auto* oversampler = getActive())
+            oversampler->reset();
+    }
+
+    bool isCrossfading() const noexcept { return outgoing != nullptr; }
+
+    // While crossfading: the oversampler being faded out (nullptr if that was no oversampling)
+    juce::dsp::Oversampling<SampleType>* getOutgoing() const noexcept
+    {
+        return outgoing != nullptr ? outgoing->oversampler.get() : nullptr;
+    }
+
+    // While crossfading: the gain of the incoming path at the start and end of this block.
+    // Call it after the outgoing path has run, since the outgoing oversampler is handed
+    // back for deletion as soon as the crossfade is complete.
+    std::pair<float, float> advanceCrossfade(int numSamples) noexcept
+    {
+        const float startGain = (float)crossfadePosition / (float)crossfadeLength;
+        crossfadePosition = juce::jmin(crossfadeLength, crossfadePosition + numSamples);
+        const float endGain = (float)crossfadePosition / (float)crossfadeLength;
+
+        if (crossfadePosition >= crossfadeLength && outgoing != nullptr)
+        {
+            retire(outgoing);
+            outgoing = nullptr;
+        }
+
+        return { startGain, endGain };
+    }
+
+    //==============================================================================
+    // Memory report. The oversamplers' memory is estimated from the sizes of their
+    // stage buffers, which dominate; the filter states and coefficients are small next to them.
+    int getNumOversamplersAlive() const noexcept { return liveOversamplers.load(); }
+    size_t getMemoryUsage() const noexcept { return liveBytes.load(); }
+
+    static size_t estimateMemoryUsage(Key key, int numChannels, int maxBlockSize) noexcept
+    {
+        // Each 2x stage keeps a buffer of its output at its own rate
+        size_t bytes = 0;
+
+        for (int stage = 0; stage < key.index; ++stage)
+            bytes += (size_t)numChannels * (size_t)maxBlockSize * ((size_t)2 << stage) * sizeof(SampleType);
+
+        return bytes;
+    }
+
+    // What building every configuration up front, as we used to, would take
+    size_t estimateMemoryUsageOfAll() const noexcept
+    {
+        size_t bytes = 0;
+
+        for (int index = 1; index <= maxIndex; ++index)
+            bytes += 2 * estimateMemoryUsage({ LinearPhase, index }, preparedChannels, preparedBlockSize);
+
+        return bytes;
+    }
+
+private:
+    struct Entry
+    {
+        Key key;
+        std::unique_ptr<juce::dsp::Oversampling<SampleType>> oversampler; // nullptr when the key is "off"
+        size_t memoryUsage = 0;
+    };
+
+    static constexpr double crossfadeSeconds = 0.01;
+
+    static int encode(Key key) noexcept { return (int)key.mode * (maxIndex + 1) + key.index; }
+    static Key decode(int code) noexcept { return { (OversamplingMode)(code / (maxIndex + 1)), code % (maxIndex + 1) }; }
+
+    std::unique_ptr<Entry> build(Key key)
+    {
+        auto entry = std::make_unique<Entry>();
+        entry->key = key;
+
+        if (key.index > 0)
+        {
+            const auto filterType = key.mode == LowLatency ? juce::dsp::Oversampling<SampleType>::filterHalfBandPolyphaseIIR
+                                                           : juce::dsp::Oversampling<SampleType>::filterHalfBandFIREquiripple;
+
+            entry->oversampler = std::make_unique<juce::dsp::Oversampling<SampleType>>(
+                (size_t)preparedChannels, (size_t)key.index, filterType, true);
+
+            entry->oversampler->initProcessing((size_t)preparedBlockSize);
+            entry->oversampler->reset();
+            entry->memoryUsage = estimateMemoryUsage(key, preparedChannels, preparedBlockSize);
+        }
+
+        liveOversamplers += entry->oversampler != nullptr ? 1 : 0;
+        liveBytes += entry->memoryUsage;
+        return entry;
+    }
+
+    void destroy(Entry* entry)
+    {
+        if (entry == nullptr)
+            return;
+
+        liveOversamplers -= entry->oversampler != nullptr ? 1 : 0;
+        liveBytes -= entry->memoryUsage;
+        delete entry;
+    }
+
+    // Audio thread: hands an entry to the background thread for deletion
+    void retire(Entry* entry) noexcept
+    {
+        for (auto& slot : retired)
+        {
+            Entry* expected = nullptr;
+
+            if (slot.compare_exchange_strong(expected, entry))
+            {
+                triggerAsyncUpdate();
+                return;
+            }
+        }
+
+        // More retired entries than slots means the background thread has stalled
+        jassertfalse;
+    }
+
+    // Message thread: starts the background thread the first time it's needed, and wakes it
+    void handleAsyncUpdate() override
+    {
+        if (!isThreadRunning())
+            startThread(juce::Thread::Priority::low);
+
+        notify();
+    }
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            for (auto& slot : retired)
+                destroy(slot.exchange(nullptr));
+
+            const auto serial = requestSerial.load();
+
+            if (serial != handledSerial && !threadShouldExit())
+            {
+                handledSerial = serial;
+
+                // If the audio thread hasn't picked up the previous build yet, this one replaces it
+                destroy(ready.exchange(build(decode(requestedKey.load())).release()));
+            }
+
+            // Anything asked for after the checks above has signalled the event, so this returns straight away
+            wait(-1);
+        }
+    }
+
+    // Audio thread state
+    Entry* active = nullptr;
+    Entry* outgoing = nullptr;
+    Key requested;
+    int crossfadePosition = 0;
+    int crossfadeLength = 1;
+
+    // Handover between the audio thread and the background thread
+    std::atomic<int> requestedKey { 0 };
+    std::atomic<uint32_t> requestSerial { 0 };
+    std::atomic<Entry*> ready { nullptr };
+    std::array<std::atomic<Entry*>, 8> retired {};
+    uint32_t handledSerial = 0; // Background thread, or prepare() while it's stopped
+
+    int preparedChannels = 0;
+    int preparedBlockSize = 0;
+
+    std::atomic<int> liveOversamplers { 0 };
+    std::atomic<size_t> liveBytes { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(OversamplerManager)
+};
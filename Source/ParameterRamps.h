@@ -0,0 +1,186 @@
+// ParameterRamps.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdFloat.h"
+#include "ParameterSnapshot.h"
+
+// Smoothing for the continuous parameters that used to jump at block boundaries: drive,
+// input and output gain, mix and width, and each band's drive and mix. A band's bypass
+// switch glides too: its mix ramps down to zero, and back up when it's switched on again.
+//
+// Every block, each parameter's smoother hands out a Ramp: where it starts, how much it
+// moves per sample, and where it stops. A ramp is a plain linear glide that is clamped at
+// its end value, so it can be evaluated anywhere in the block without stepping through
+// it, and four samples at a time with Simd::Float4::ramp().
+//
+// The gain stages apply their ramps sample by sample. The distortion chain can't take a
+// different drive on every sample, so while drive is moving the block is split into
+// sub-blocks of subBlockSize samples, each run with the value the ramp has at its middle.
+// A parameter that isn't moving gives a ramp with a zero step, and everything that uses it
+// takes the same single-value path as before.
+namespace ParameterRamps
+{
+    // How long a parameter takes to glide to a new value
+    static constexpr double rampSeconds = 0.02;
+
+    // While drive is moving, the chain runs in pieces of this many samples at the base rate
+    static constexpr int subBlockSize = 32;
+
+    //==============================================================================
+    // One parameter over one block: start, start + step, start + 2 * step ... held at end
+    struct Ramp
+    {
+        float start = 0.0f;
+        float step = 0.0f;
+        float end = 0.0f;
+
+        static Ramp constant(float value) noexcept { return { value, 0.0f, value }; }
+
+        bool isMoving() const noexcept { return start != end; }
+
+        // The value at a (fractional) sample position in the block
+        float at(float position) const noexcept
+        {
+            return juce::jlimit(juce::jmin(start, end), juce::jmax(start, end), start + step * position);
+        }
+
+        // The values of the samples from index onwards, one per element of Vec
+        template <typename Vec>
+        Vec at(int index) const noexcept
+        {
+            const auto values = Vec::ramp(start + step * (float)index, step);
+            return Vec::min(Vec::max(values, Vec::expand(juce::jmin(start, end))), Vec::expand(juce::jmax(start, end)));
+        }
+    };
+
+    //==============================================================================
+    // A linear glide to the latest value, like juce::SmoothedValue, that can hand out a whole
+    // block of its output as a Ramp
+    class Smoother
+    {
+    public:
+        void reset(double sampleRate, float value) noexcept
+        {
+            rampLength = juce::jmax(1, juce::roundToInt(sampleRate * rampSeconds));
+            current = target = value;
+            step = 0.0f;
+            remaining = 0;
+        }
+
+        Ramp next(float newTarget, int numSamples) noexcept
+        {
+            if (newTarget != target)
+            {
+                target = newTarget;
+                step = (target - current) / (float)rampLength;
+                remaining = rampLength;
+            }
+
+            if (remaining == 0)
+                return Ramp::constant(target);
+
+            const Ramp ramp { current, step, target };
+
+            if (numSamples >= remaining)
+            {
+                current = target;
+                remaining = 0;
+            }
+            else
+            {
+                current += step * (float)numSamples;
+                remaining -= numSamples;
+            }
+
+            return ramp;
+        }
+
+    private:
+        float current = 0.0f;
+        float target = 0.0f;
+        float step = 0.0f;
+        int remaining = 0;
+        int rampLength = 1;
+    };
+
+    //==============================================================================
+    // Every smoothed parameter's ramp for one block
+    struct BlockRamps
+    {
+        Ramp drive, inputGain, outputGain, mix, width;
+        std::array<Ramp, Multiband::maxBands> bandDrive, bandMix;
+
+        // Whether anything the distortion chain reads is moving, so it needs sub-blocks
+        bool isChainMoving() const noexcept
+        {
+            if (drive.isMoving())
+                return true;
+
+            for (size_t band = 0; band < bandDrive.size(); ++band)
+                if (bandDrive[band].isMoving() || bandMix[band].isMoving())
+                    return true;
+
+            return false;
+        }
+
+        // Puts the chain's values at a sample position (at the base rate) into the snapshot
+        void applyTo(ParameterSnapshot& params, float position) const noexcept
+        {
+            params.drive = drive.at(position);
+
+            for (size_t band = 0; band < params.bands.size(); ++band)
+            {
+                params.bands[band].drive = bandDrive[band].at(position);
+                params.bands[band].mix = bandMix[band].at(position);
+
+                // The mix ramp carries the bypass, so a band fading out keeps its shaper until it's gone
+                params.bands[band].bypass = false;
+            }
+        }
+    };
+
+    // Audio thread only
+    class Smoothers
+    {
+    public:
+        // Jumps straight to the given values, e.g. in prepareToPlay
+        void reset(double sampleRate, const ParameterSnapshot& params) noexcept
+        {
+            drive.reset(sampleRate, params.drive);
+            inputGain.reset(sampleRate, params.inputGain);
+            outputGain.reset(sampleRate, params.outputGain);
+            mix.reset(sampleRate, params.mix);
+            width.reset(sampleRate, params.stereoWidth);
+
+            for (size_t band = 0; band < params.bands.size(); ++band)
+            {
+                bandDrive[band].reset(sampleRate, params.bands[band].drive);
+                bandMix[band].reset(sampleRate, params.bands[band].getEffectiveMix());
+            }
+        }
+
+        // Once per block, however much of it gets processed
+        BlockRamps next(const ParameterSnapshot& params, int numSamples) noexcept
+        {
+            BlockRamps ramps;
+            ramps.drive = drive.next(params.drive, numSamples);
+            ramps.inputGain = inputGain.next(params.inputGain, numSamples);
+            ramps.outputGain = outputGain.next(params.outputGain, numSamples);
+            ramps.mix = mix.next(params.mix, numSamples);
+            ramps.width = width.next(params.stereoWidth, numSamples);
+
+            for (size_t band = 0; band < params.bands.size(); ++band)
+            {
+                ramps.bandDrive[band] = bandDrive[band].next(params.bands[band].drive, numSamples);
+                ramps.bandMix[band] = bandMix[band].next(params.bands[band].getEffectiveMix(), numSamples);
+            }
+
+            return ramps;
+        }
+
+    private:
+        Smoother drive, inputGain, outputGain, mix, width;
+        std::array<Smoother, Multiband::maxBands> bandDrive, bandMix;
+    };
+}
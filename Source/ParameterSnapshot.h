@@ -0,0 +1,241 @@
+// ParameterSnapshot.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "Multiband.h"
+
+// <<< ADD THESE ENUMS for clarity and type safety
+enum FilterType { LowPass, HighPass, BandPass };
+enum FilterRouting { Pre, Post };
+
+// <<< ADD THIS ENUM FOR OUR NEW DISTORTION TYPES
+enum DistortionType { SoftClip, HardClip, Foldback, BitGlitch };
+
+// Linear phase uses the FIR half-band filters, low latency the polyphase IIR ones
+enum OversamplingMode { LinearPhase, LowLatency };
+
+// Which left/right pairs the stereo width applies to on multichannel layouts
+enum WidthPairs { FrontPair, AllPairs };
+
+// One band of the multiband mode
+struct BandSettings
+{
+    float drive = 1.0f;
+    DistortionType type = SoftClip;
+    float mix = 1.0f;
+    bool bypass = false;
+
+    // Bypassed bands, and bands mixed fully dry, are only summed back, never shaped
+    bool isActive() const noexcept { return !bypass && mix > 0.0f; }
+
+    // The mix the band ends up at, with a bypassed band fully dry
+    float getEffectiveMix() const noexcept { return bypass ? 0.0f : mix; }
+};
+
+// Parameter IDs of the multiband settings: "crossover1" to "crossover3", "band1Drive" to "band4Bypass"
+inline juce::String getCrossoverParameterID(int crossover) { return "crossover" + juce::String(crossover + 1); }
+inline juce::String getBandParameterID(int band, const char* name) { return "band" + juce::String(band + 1) + name; }
+
+// Every parameter the DSP needs, read once at the start of a block.
+// Passing this around gives all processing stages the same consistent view of the
+// parameters for the whole block.
+struct ParameterSnapshot
+{
+    // Distortion
+    float drive = 1.0f;
+    int bitDepth = 16;
+    float sampleRateReduction = 0.0f;
+    bool decimatorBandLimited = false; // Lowpass in front of the sample rate reducer
+    bool decimatorFractional = false;  // Grab at the exact fractional position instead of the nearest sample
+    float mix = 1.0f;
+    DistortionType distortionType = SoftClip;
+    bool fastMath = false; // Cheaper tanh/sin approximations in the shapers
+    int antiAliasing = 0;  // ADAA order for the shapers: 0 = off, 1 or 2
+    bool multiCore = false; // Spread the channels of big blocks over several cores
+    bool sleepWhenSilent = true; // Skip processing once the input has been silent for longer than the tail
+
+    // Multiband: with more than one band, each band's drive, type and mix take the place of the ones above
+    int numBands = 1;
+    std::array<float, Multiband::maxCrossovers> crossoverFrequencies { 150.0f, 1000.0f, 5000.0f };
+    std::array<BandSettings, Multiband::maxBands> bands {};
+
+    // Filter
+    float filterCutoff = 20000.0f;
+    float filterResonance = 1.0f;
+    FilterType filterType = LowPass;
+    FilterRouting filterRouting = Post;
+
+    // Oversampling (0 = off, 1 = 2x ... 4 = 16x)
+    int oversamplingIndex = 1;
+    OversamplingMode oversamplingMode = LinearPhase;
+
+    // Gains are stored as linear factors, not dB
+    float inputGain = 1.0f;
+    float outputGain = 1.0f;
+    float stereoWidth = 1.0f;
+    WidthPairs widthPairs = FrontPair;
+
+    // Limiter
+    bool limiterEnabled = true;
+    float limiterThreshold = -0.5f; // dB true peak
+    float limiterRelease = 100.0f;  // ms
+    bool limiterLink = true;        // One gain for every channel, from the loudest
+
+    bool bypass = false;
+};
+
+// The raw parameter values, looked up by ID once when the processor is constructed,
+// so the audio thread never has to do string-keyed lookups.
+class ParameterBindings
+{
+public:
+    explicit ParameterBindings(juce::AudioProcessorValueTreeState& state)
+        : drive(bind(state, "drive")),
+          bitDepth(bind(state, "bitdepth")),
+          sampleRateReduction(bind(state, "samplerate")),
+          decimatorBandLimited(bind(state, "decimatorBandLimited")),
+          decimatorFractional(bind(state, "decimatorFractional")),
+          mix(bind(state, "mix")),
+          distortionType(bind(state, "distortionType")),
+          fastMath(bind(state, "fastMath")),
+          antiAliasing(bind(state, "antiAliasing")),
+          multiCore(bind(state, "multiCore")),
+          sleepWhenSilent(bind(state, "sleepWhenSilent")),
+          filterCutoff(bind(state, "filterCutoff")),
+          filterResonance(bind(state, "filterResonance")),
+          filterType(bind(state, "filterType")),
+          filterRouting(bind(state, "filterRouting")),
+          oversamplingFactor(bind(state, "oversamplingFactor")),
+          oversamplingMode(bind(state, "oversamplingMode")),
+          inputGain(bind(state, "inputGain")),
+          outputGain(bind(state, "outputGain")),
+          stereoWidth(bind(state, "stereoWidth")),
+          widthPairs(bind(state, "widthPairs")),
+          limiterEnabled(bind(state, "limiterEnabled")),
+          limiterThreshold(bind(state, "limiterThreshold")),
+          limiterRelease(bind(state, "limiterRelease")),
+          limiterLink(bind(state, "limiterLink")),
+          bypass(bind(state, "bypass")),
+          numBands(bind(state, "numBands"))
+    {
+        for (int crossover = 0; crossover < Multiband::maxCrossovers; ++crossover)
+            crossoverFrequencies[(size_t)crossover] = bind(state, getCrossoverParameterID(crossover));
+
+        for (int band = 0; band < Multiband::maxBands; ++band)
+        {
+            auto& binding = bands[(size_t)band];
+            binding.drive = bind(state, getBandParameterID(band, "Drive"));
+            binding.type = bind(state, getBandParameterID(band, "Type"));
+            binding.mix = bind(state, getBandParameterID(band, "Mix"));
+            binding.bypass = bind(state, getBandParameterID(band, "Bypass"));
+        }
+    }
+
+    // Reads every parameter into a snapshot. Safe to call from the audio thread.
+    ParameterSnapshot load() const noexcept
+    {
+        ParameterSnapshot snapshot;
+
+        snapshot.drive = read(drive);
+        snapshot.bitDepth = static_cast<int>(read(bitDepth));
+        snapshot.sampleRateReduction = read(sampleRateReduction);
+        snapshot.decimatorBandLimited = read(decimatorBandLimited) > 0.5f;
+        snapshot.decimatorFractional = read(decimatorFractional) > 0.5f;
+        snapshot.mix = read(mix);
+        snapshot.distortionType = static_cast<DistortionType>(static_cast<int>(read(distortionType)));
+        snapshot.fastMath = read(fastMath) > 0.5f;
+        snapshot.antiAliasing = static_cast<int>(read(antiAliasing));
+        snapshot.multiCore = read(multiCore) > 0.5f;
+        snapshot.sleepWhenSilent = read(sleepWhenSilent) > 0.5f;
+
+        snapshot.numBands = static_cast<int>(read(numBands)) + 1;
+
+        for (size_t crossover = 0; crossover < crossoverFrequencies.size(); ++crossover)
+            snapshot.crossoverFrequencies[crossover] = read(crossoverFrequencies[crossover]);
+
+        for (size_t band = 0; band < bands.size(); ++band)
+        {
+            auto& settings = snapshot.bands[band];
+            settings.drive = read(bands[band].drive);
+            settings.type = static_cast<DistortionType>(static_cast<int>(read(bands[band].type)));
+            settings.mix = read(bands[band].mix);
+            settings.bypass = read(bands[band].bypass) > 0.5f;
+        }
+
+        snapshot.filterCutoff = read(filterCutoff);
+        snapshot.filterResonance = read(filterResonance);
+        snapshot.filterType = static_cast<FilterType>(static_cast<int>(read(filterType)));
+        snapshot.filterRouting = static_cast<FilterRouting>(static_cast<int>(read(filterRouting)));
+
+        snapshot.oversamplingIndex = static_cast<int>(read(oversamplingFactor));
+        snapshot.oversamplingMode = static_cast<OversamplingMode>(static_cast<int>(read(oversamplingMode)));
+
+        snapshot.inputGain = juce::Decibels::decibelsToGain(read(inputGain));
+        snapshot.outputGain = juce::Decibels::decibelsToGain(read(outputGain));
+        snapshot.stereoWidth = read(stereoWidth);
+        snapshot.widthPairs = static_cast<WidthPairs>(static_cast<int>(read(widthPairs)));
+
+        snapshot.limiterEnabled = read(limiterEnabled) > 0.5f;
+        snapshot.limiterThreshold = read(limiterThreshold);
+        snapshot.limiterRelease = read(limiterRelease);
+        snapshot.limiterLink = read(limiterLink) > 0.5f;
+
+        snapshot.bypass = read(bypass) > 0.5f;
+
+        return snapshot;
+    }
+
+private:
+    static std::atomic<float>* bind(juce::AudioProcessorValueTreeState& state, juce::StringRef parameterID)
+    {
+        auto* value = state.getRawParameterValue(parameterID);
+        jassert(value != nullptr); // The ID doesn't match anything in createParameterLayout()
+        return value;
+    }
+
+    static float read(const std::atomic<float>* value) noexcept
+    {
+        return value->load(std::memory_order_relaxed);
+    }
+
+    const std::atomic<float>* const drive;
+    const std::atomic<float>* const bitDepth;
+    const std::atomic<float>* const sampleRateReduction;
+    const std::atomic<float>* const decimatorBandLimited;
+    const std::atomic<float>* const decimatorFractional;
+    const std::atomic<float>* const mix;
+    const std::atomic<float>* const distortionType;
+    const std::atomic<float>* const fastMath;
+    const std::atomic<float>* const antiAliasing;
+    const std::atomic<float>* const multiCore;
+    const std::atomic<float>* const sleepWhenSilent;
+    const std::atomic<float>* const filterCutoff;
+    const std::atomic<float>* const filterResonance;
+    const std::atomic<float>* const filterType;
+    const std::atomic<float>* const filterRouting;
+    const std::atomic<float>* const oversamplingFactor;
+    const std::atomic<float>* const oversamplingMode;
+    const std::atomic<float>* const inputGain;
+    const std::atomic<float>* const outputGain;
+    const std::atomic<float>* const stereoWidth;
+    const std::atomic<float>* const widthPairs;
+    const std::atomic<float>* const limiterEnabled;
+    const std::atomic<float>* const limiterThreshold;
+    const std::atomic<float>* const limiterRelease;
+    const std::atomic<float>* const limiterLink;
+    const std::atomic<float>* const bypass;
+    const std::atomic<float>* const numBands;
+
+    struct BandBindings
+    {
+        const std::atomic<float>* drive = nullptr;
+        const std::atomic<float>* type = nullptr;
+        const std::atomic<float>* mix = nullptr;
+        const std::atomic<float>* bypass = nullptr;
+    };
+
+    std::array<const std::atomic<float>*, Multiband::maxCrossovers> crossoverFrequencies {};
+    std::array<BandBindings, Multiband::maxBands> bands {};
+
+    JUCE_DECLARE_NON_COPYABLE(ParameterBindings)
+};
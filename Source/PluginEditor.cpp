@@ -26,6 +26,17 @@ NaniDistortionAudioProcessorEditor::NaniDistortionAudioProcessorEditor(NaniDisto
     setupLinearSlider(bitDepthSlider, bitDepthLabel, "bitdepth", "Bit Depth", bitDepthAttachment);
     setupLinearSlider(sampleRateSlider, sampleRateLabel, "samplerate", "Sample Rate", sampleRateAttachment);
     setupLinearSlider(mixSlider, mixLabel, "mix", "Mix", mixAttachment);
+
+    // Sample rate reduction options
+    addAndMakeVisible(decimatorBandLimitedButton);
+    decimatorBandLimitedButton.setButtonText("Smooth");
+    decimatorBandLimitedAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        vts, "decimatorBandLimited", decimatorBandLimitedButton);
+
+    addAndMakeVisible(decimatorFractionalButton);
+    decimatorFractionalButton.setButtonText("Exact");
+    decimatorFractionalAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        vts, "decimatorFractional", decimatorFractionalButton);
     
     // --- Filter Components (Rotary) ---
     addAndMakeVisible(filterCutoffSlider);
@@ -73,6 +84,11 @@ NaniDistortionAudioProcessorEditor::NaniDistortionAudioProcessorEditor(NaniDisto
     distortionTypeLabel.setText("Distortion Mode", juce::dontSendNotification);
     distortionTypeLabel.attachToComponent(&distortionTypeComboBox, true);
 
+    // Anti-aliasing mode for the shapers
+    addAndMakeVisible(antiAliasingComboBox);
+    antiAliasingComboBox.addItemList({ "No ADAA", "ADAA 1", "ADAA 2" }, 1);
+    antiAliasingAttachment = std::make_unique<ComboBoxAttachment>(vts, "antiAliasing", antiAliasingComboBox);
+
     setSize(500, 500); // <<< Increase height slightly for the new control
 
     // Add this to your constructor in PluginEditor.cpp:
@@ -83,9 +99,37 @@ NaniDistortionAudioProcessorEditor::NaniDistortionAudioProcessorEditor(NaniDisto
     oversamplingLabel.setText("Oversampling", juce::dontSendNotification);
     oversamplingLabel.attachToComponent(&oversamplingComboBox, true);
 
+    // Oversampling filter mode
+    addAndMakeVisible(oversamplingModeComboBox);
+    oversamplingModeComboBox.addItemList({ "Linear Phase", "Low Latency" }, 1);
+    oversamplingModeAttachment = std::make_unique<ComboBoxAttachment>(vts, "oversamplingMode", oversamplingModeComboBox);
+
     // Increase the window size to accommodate the new control
     setSize(500, 530);
 
+    // Fast math toggle
+    addAndMakeVisible(fastMathButton);
+    fastMathButton.setButtonText("Fast Math");
+    fastMathAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        processor.getValueTreeState(), "fastMath", fastMathButton);
+
+    // Multi-core toggle
+    addAndMakeVisible(multiCoreButton);
+    multiCoreButton.setButtonText("Multi-Core");
+    multiCoreAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        processor.getValueTreeState(), "multiCore", multiCoreButton);
+
+    // Sleep-when-silent toggle, with an indicator that lights up while processing is skipped
+    addAndMakeVisible(sleepWhenSilentButton);
+    sleepWhenSilentButton.setButtonText("Sleep");
+    sleepWhenSilentAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        processor.getValueTreeState(), "sleepWhenSilent", sleepWhenSilentButton);
+
+    addChildComponent(sleepingLabel);
+    sleepingLabel.setText("Sleeping", juce::dontSendNotification);
+    sleepingLabel.setJustificationType(juce::Justification::centredLeft);
+    sleepingLabel.setColour(juce::Label::textColourId, juce::Colours::lightgreen);
+
     // Preset ComboBox
     addAndMakeVisible(presetComboBox);
     presetComboBox.setTextWhenNothingSelected("Select Preset");
@@ -120,6 +164,18 @@ NaniDistortionAudioProcessorEditor::NaniDistortionAudioProcessorEditor(NaniDisto
     limiterEnabledAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
         processor.getValueTreeState(), "limiterEnabled", limiterEnabledButton);
 
+    // Stereo link, on the same row
+    addAndMakeVisible(limiterLinkButton);
+    limiterLinkButton.setButtonText("Stereo Link");
+    limiterLinkAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        processor.getValueTreeState(), "limiterLink", limiterLinkButton);
+
+    // Loudness of the output, between the two; clicking it starts a new measurement
+    addAndMakeVisible(loudnessLabel);
+    loudnessLabel.setJustificationType(juce::Justification::centred);
+    loudnessLabel.setFont(juce::FontOptions(12.0f));
+    loudnessLabel.addMouseListener(this, false);
+
     // Limiter Threshold
     addAndMakeVisible(limiterThresholdSlider);
     limiterThresholdSlider.setSliderStyle(juce::Slider::LinearHorizontal);
@@ -193,7 +249,9 @@ NaniDistortionAudioProcessorEditor::NaniDistortionAudioProcessorEditor(NaniDisto
     // Adjust window size to accommodate meters
     setSize(600, 820); // Wider to fit meters on sides
 
-    // Start a timer to update the meters
+    // Start a timer to update the meters, ignoring whatever the processor metered before we opened
+    processor.getMeterTransport().discardAll();
+    lastMeterUpdateTime = juce::Time::getMillisecondCounterHiRes();
     startTimerHz(30); // 30 fps is smooth enough for meters (Increase for reactive meters)
 
 	// Reset Clip Button
@@ -225,6 +283,57 @@ NaniDistortionAudioProcessorEditor::NaniDistortionAudioProcessorEditor(NaniDisto
     stereoWidthLabel.setJustificationType(juce::Justification::centred);
     stereoWidthLabel.attachToComponent(&stereoWidthSlider, false);
 
+    // Which channel pairs the width applies to, on surround layouts
+    addAndMakeVisible(widthPairsComboBox);
+    widthPairsComboBox.addItemList({ "Front", "All Pairs" }, 1);
+    widthPairsAttachment = std::make_unique<ComboBoxAttachment>(processor.getValueTreeState(), "widthPairs", widthPairsComboBox);
+    widthPairsComboBox.setEnabled(processor.getTotalNumOutputChannels() > 2);
+
+    // Multiband mode: band count, crossover frequencies, and a column of controls per band
+    addAndMakeVisible(numBandsComboBox);
+    numBandsComboBox.addItemList({ "1 Band", "2 Bands", "3 Bands", "4 Bands" }, 1);
+    numBandsComboBox.onChange = [this] { updateMultibandControls(); };
+    numBandsAttachment = std::make_unique<ComboBoxAttachment>(vts, "numBands", numBandsComboBox);
+
+    for (int crossover = 0; crossover < Multiband::maxCrossovers; ++crossover)
+    {
+        auto& slider = crossoverSliders[(size_t)crossover];
+        addAndMakeVisible(slider);
+        slider.setSliderStyle(juce::Slider::LinearHorizontal);
+        slider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
+        slider.setValueDisplayMode(CustomSlider::Hertz);
+        crossoverAttachments[(size_t)crossover] = std::make_unique<SliderAttachment>(vts, getCrossoverParameterID(crossover), slider);
+    }
+
+    for (int band = 0; band < Multiband::maxBands; ++band)
+    {
+        auto& controls = bandControls[(size_t)band];
+
+        addAndMakeVisible(controls.bypassButton);
+        controls.bypassButton.setButtonText("Bypass Band " + juce::String(band + 1));
+        controls.bypassAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+            vts, getBandParameterID(band, "Bypass"), controls.bypassButton);
+
+        addAndMakeVisible(controls.typeComboBox);
+        controls.typeComboBox.addItemList({ "Soft Clip", "Hard Clip", "Foldback", "Bit Glitch" }, 1);
+        controls.typeAttachment = std::make_unique<ComboBoxAttachment>(vts, getBandParameterID(band, "Type"), controls.typeComboBox);
+
+        for (auto* slider : { &controls.driveSlider, &controls.mixSlider })
+        {
+            addAndMakeVisible(*slider);
+            slider->setSliderStyle(juce::Slider::LinearHorizontal);
+            slider->setTextBoxStyle(juce::Slider::TextBoxRight, false, 55, 20);
+        }
+
+        // Drive reads as a multiplier and mix as a percentage, as in the distortion section
+        controls.driveSlider.setValueDisplayMode(CustomSlider::Times);
+        controls.mixSlider.setValueDisplayMode(CustomSlider::Percentage);
+        controls.driveAttachment = std::make_unique<SliderAttachment>(vts, getBandParameterID(band, "Drive"), controls.driveSlider);
+        controls.mixAttachment = std::make_unique<SliderAttachment>(vts, getBandParameterID(band, "Mix"), controls.mixSlider);
+    }
+
+    updateMultibandControls();
+
     // Input and Output Gain
     inputGainSlider.setValueDisplayMode(CustomSlider::Decibels);
     outputGainSlider.setValueDisplayMode(CustomSlider::Decibels);
@@ -259,13 +368,20 @@ NaniDistortionAudioProcessorEditor::NaniDistortionAudioProcessorEditor(NaniDisto
     // At the end of your constructor
     updateAllSliderDisplays();
 
-    // Adjust window size to accommodate meters
-    setSize(600, 760); 
+    // Spectrum display, with the analysis thread running for as long as the editor is open
+    addAndMakeVisible(spectrumDisplay);
+    processor.getSpectrumAnalyser().start();
+
+    // Adjust window size to accommodate meters, the multiband section and the spectrum
+    setSize(600, 1130);
 }
 
 NaniDistortionAudioProcessorEditor::~NaniDistortionAudioProcessorEditor() 
 {
     stopTimer();
+
+    // Nobody is looking at the spectrum any more
+    processor.getSpectrumAnalyser().stop();
 }
 
 void NaniDistortionAudioProcessorEditor::paint(juce::Graphics& g)
@@ -308,6 +424,8 @@ void NaniDistortionAudioProcessorEditor::paint(juce::Graphics& g)
     drawSectionDivider(510, "Presets");
     drawSectionDivider(570, "");
     drawSectionDivider(660, "Limiter");
+    drawSectionDivider(790, "Multiband");
+    drawSectionDivider(spectrumDisplay.getY() - 10, "Spectrum");
 }
 
 void NaniDistortionAudioProcessorEditor::resized()
@@ -331,6 +449,9 @@ void NaniDistortionAudioProcessorEditor::resized()
     // Title (center)
     auto titleArea = headerSection.removeFromLeft(headerSection.getWidth() - 140); // Adjusted width
 
+    // Width channel pairs, just left of the width control
+    widthPairsComboBox.setBounds(titleArea.removeFromRight(90).withSizeKeepingCentre(90, 22));
+
     // Stereo width (top right) - increased area and adjusted position
     auto stereoWidthArea = headerSection.removeFromRight(140); // Increased width
 
@@ -397,7 +518,14 @@ void NaniDistortionAudioProcessorEditor::resized()
     mainContent.removeFromTop(sectionSpacing);
     createSliderLayout(driveSlider, driveLabel);
     createSliderLayout(bitDepthSlider, bitDepthLabel);
-    createSliderLayout(sampleRateSlider, sampleRateLabel);
+
+    // The sample rate slider shares its row with its band-limit and fractional rate toggles
+    auto sampleRateArea = mainContent.removeFromTop(sliderHeight);
+    sampleRateLabel.setBounds(sampleRateArea.removeFromLeft(labelWidth).reduced(5, 0));
+    decimatorFractionalButton.setBounds(sampleRateArea.removeFromRight(65));
+    decimatorBandLimitedButton.setBounds(sampleRateArea.removeFromRight(70));
+    sampleRateSlider.setBounds(sampleRateArea.reduced(5, 0));
+
     createSliderLayout(mixSlider, mixLabel);
 
     // ===== COMBO BOXES SECTION =====
@@ -411,10 +539,21 @@ void NaniDistortionAudioProcessorEditor::resized()
             mainContent.removeFromTop(comboBoxMargin);
         };
 
-    createComboBoxLayout(distortionTypeComboBox);
+    // The distortion mode shares its row with the anti-aliasing mode for its shapers
+    auto distortionRow = mainContent.removeFromTop(comboBoxHeight).reduced(mainContent.getWidth() * 0.15, 0);
+    antiAliasingComboBox.setBounds(distortionRow.removeFromRight(100));
+    distortionTypeComboBox.setBounds(distortionRow.withTrimmedRight(5));
+    mainContent.removeFromTop(comboBoxMargin);
+
     createComboBoxLayout(filterTypeComboBox);
     createComboBoxLayout(filterRoutingComboBox);
-    createComboBoxLayout(oversamplingComboBox);
+
+    // Oversampling shares its row with its filter mode and the fast math toggle it trades off against
+    auto oversamplingRow = mainContent.removeFromTop(comboBoxHeight).reduced(mainContent.getWidth() * 0.15, 0);
+    fastMathButton.setBounds(oversamplingRow.removeFromRight(100));
+    oversamplingModeComboBox.setBounds(oversamplingRow.removeFromRight(110).withTrimmedRight(5));
+    oversamplingComboBox.setBounds(oversamplingRow.withTrimmedRight(5));
+    mainContent.removeFromTop(comboBoxMargin);
 
     // ===== PRESET SECTION =====
     mainContent.removeFromTop(sectionSpacing);
@@ -447,12 +586,21 @@ void NaniDistortionAudioProcessorEditor::resized()
     int buttonY = resetButtonArea.getCentreY() - buttonHeight / 2;
     resetClipButton.setBounds(buttonX, buttonY, buttonWidth, buttonHeight);
 
+    // The multi-core toggle sits at the right end of the same row
+    multiCoreButton.setBounds(resetButtonArea.removeFromRight(100).withSizeKeepingCentre(100, buttonHeight));
+
+    // And the sleep toggle and its indicator at the left end
+    sleepWhenSilentButton.setBounds(resetButtonArea.removeFromLeft(80).withSizeKeepingCentre(80, buttonHeight));
+    sleepingLabel.setBounds(resetButtonArea.removeFromLeft(80).withSizeKeepingCentre(80, buttonHeight));
+
     // ===== LIMITER SECTION =====
     mainContent.removeFromTop(sectionSpacing);
 
     // Limiter toggle
     auto limiterHeaderArea = mainContent.removeFromTop(30);
-    limiterEnabledButton.setBounds(limiterHeaderArea.reduced(10, 0));
+    limiterLinkButton.setBounds(limiterHeaderArea.removeFromRight(120).reduced(10, 0));
+    limiterEnabledButton.setBounds(limiterHeaderArea.removeFromLeft(100).reduced(10, 0));
+    loudnessLabel.setBounds(limiterHeaderArea);
 
     // Place limiter sliders side by side to save vertical space
     auto limiterSlidersArea = mainContent.removeFromTop(sliderHeight);
@@ -464,6 +612,35 @@ void NaniDistortionAudioProcessorEditor::resized()
     limiterReleaseLabel.setBounds(limiterReleaseArea.removeFromLeft(labelWidth).reduced(5, 0));
     limiterReleaseSlider.setBounds(limiterReleaseArea.reduced(5, 0));
 
+    // ===== MULTIBAND SECTION =====
+    mainContent.removeFromTop(sectionSpacing + 20); // Room for the section title
+
+    // Band count, then the crossover frequencies between the bands
+    auto crossoverRow = mainContent.removeFromTop(sliderHeight);
+    numBandsComboBox.setBounds(crossoverRow.removeFromLeft(90).withSizeKeepingCentre(90, comboBoxHeight));
+    const int crossoverWidth = crossoverRow.getWidth() / Multiband::maxCrossovers;
+
+    for (auto& slider : crossoverSliders)
+        slider.setBounds(crossoverRow.removeFromLeft(crossoverWidth).reduced(5, 0));
+
+    // A column per band, lowest on the left
+    auto bandsArea = mainContent.removeFromTop(comboBoxHeight * 2 + comboBoxMargin + 60);
+    const int bandWidth = bandsArea.getWidth() / Multiband::maxBands;
+
+    for (auto& controls : bandControls)
+    {
+        auto column = bandsArea.removeFromLeft(bandWidth).reduced(3, 0);
+        controls.bypassButton.setBounds(column.removeFromTop(comboBoxHeight));
+        controls.typeComboBox.setBounds(column.removeFromTop(comboBoxHeight));
+        column.removeFromTop(comboBoxMargin);
+        controls.driveSlider.setBounds(column.removeFromTop(30));
+        controls.mixSlider.setBounds(column.removeFromTop(30));
+    }
+
+    // ===== SPECTRUM SECTION =====
+    mainContent.removeFromTop(sectionSpacing + 20);
+    spectrumDisplay.setBounds(mainContent.removeFromTop(120).reduced(10, 0));
+
     // Add some padding at the bottom
     mainContent.removeFromTop(20);
 }
@@ -585,15 +762,79 @@ void NaniDistortionAudioProcessorEditor::updateAllSliderDisplays()
     limiterThresholdSlider.updateTextDisplay();
     limiterReleaseSlider.updateTextDisplay();
     stereoWidthSlider.updateTextDisplay();
+
+    for (auto& slider : crossoverSliders)
+        slider.updateTextDisplay();
+
+    for (auto& controls : bandControls)
+    {
+        controls.driveSlider.updateTextDisplay();
+        controls.mixSlider.updateTextDisplay();
+    }
+}
+
+void NaniDistortionAudioProcessorEditor::updateMultibandControls()
+{
+    const int numBands = numBandsComboBox.getSelectedItemIndex() + 1;
+
+    // With N bands, only the first N - 1 crossovers are in use
+    for (int crossover = 0; crossover < Multiband::maxCrossovers; ++crossover)
+        crossoverSliders[(size_t)crossover].setEnabled(crossover < numBands - 1);
+
+    // A single band is the classic mode, which uses the distortion section's settings instead
+    for (int band = 0; band < Multiband::maxBands; ++band)
+    {
+        auto& controls = bandControls[(size_t)band];
+        const bool inUse = numBands > 1 && band < numBands;
+
+        for (auto* component : std::initializer_list<juce::Component*> { &controls.bypassButton, &controls.typeComboBox,
+                                                                         &controls.driveSlider, &controls.mixSlider })
+            component->setEnabled(inUse);
+    }
+}
+
+void NaniDistortionAudioProcessorEditor::mouseDown(const juce::MouseEvent& event)
+{
+    // A click on the loudness readout resets the measurement
+    if (event.eventComponent == &loudnessLabel)
+        processor.getLoudnessMeter().reset();
 }
 
 void NaniDistortionAudioProcessorEditor::timerCallback()
 {
-    // Update the level meters
-    inputLevelMeterL.setLevel(processor.getInputLevel(0));
-    inputLevelMeterR.setLevel(processor.getInputLevel(1));
-    outputLevelMeterL.setLevel(processor.getOutputLevel(0));
-    outputLevelMeterR.setLevel(processor.getOutputLevel(1));
+    // Read the frames the processor has sent since last time and update the level meters
+    const double now = juce::Time::getMillisecondCounterHiRes();
+    meterBallistics.update(processor.getMeterTransport(), (now - lastMeterUpdateTime) * 0.001);
+    lastMeterUpdateTime = now;
+
+    auto showLevel = [](LevelMeter& meter, const Metering::Ballistics::Level& level)
+    {
+        meter.setLevel(level.peak, level.rms, level.numClipped);
+    };
+
+    // A mono layout shows its one channel on both meters
+    const int rightChannel = processor.getTotalNumOutputChannels() > 1 ? 1 : 0;
+
+    showLevel(inputLevelMeterL, meterBallistics.getInput(0));
+    showLevel(inputLevelMeterR, meterBallistics.getInput(rightChannel));
+    showLevel(outputLevelMeterL, meterBallistics.getOutput(0));
+    showLevel(outputLevelMeterR, meterBallistics.getOutput(rightChannel));
+
+    sleepingLabel.setVisible(processor.isSleeping());
+
+    // Loudness, worked out on the meter's own thread
+    const auto loudness = processor.getLoudnessMeter().getReading();
+
+    auto format = [](float value)
+    {
+        return std::isfinite(value) ? juce::String(value, 1) : juce::String("-inf");
+    };
+
+    loudnessLabel.setText("M " + format(loudness.momentary) + "  S " + format(loudness.shortTerm)
+                              + "  I " + format(loudness.integrated) + " LUFS  TP " + format(loudness.truePeak),
+                          juce::dontSendNotification);
+
+    spectrumDisplay.update(processor.getSpectrumAnalyser());
 
     // Update slider displays on first timer call
     static bool firstTimerCall = true;
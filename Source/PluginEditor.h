@@ -4,6 +4,7 @@
 #include "PluginProcessor.h"
 #include "LevelMeter.h"
 #include "CustomSlider.h"
+#include "SpectrumDisplay.h"
 
 // A handy alias for the long attachment class names to keep code clean
 using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
@@ -21,6 +22,8 @@ public:
     // Add this declaration for the timer callback
     void timerCallback() override;
 
+    void mouseDown(const juce::MouseEvent& event) override;
+
 	// Method to update all slider displays
     void updateAllSliderDisplays();
 
@@ -65,11 +68,21 @@ private:
     std::unique_ptr<SliderAttachment> sampleRateAttachment;
     std::unique_ptr<SliderAttachment> mixAttachment;
 
+    // Sample rate reduction options
+    juce::ToggleButton decimatorBandLimitedButton;
+    juce::ToggleButton decimatorFractionalButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> decimatorBandLimitedAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> decimatorFractionalAttachment;
+
     // Distortion Dropdown Menu
     juce::ComboBox distortionTypeComboBox;
     juce::Label distortionTypeLabel;
     std::unique_ptr<ComboBoxAttachment> distortionTypeAttachment;
 
+    // Anti-aliasing (ADAA) mode for the shapers
+    juce::ComboBox antiAliasingComboBox;
+    std::unique_ptr<ComboBoxAttachment> antiAliasingAttachment;
+
     // Filter Components
     //juce::Slider filterCutoffSlider;
     //juce::Slider filterResonanceSlider;
@@ -91,6 +104,23 @@ private:
     juce::Label oversamplingLabel;
     std::unique_ptr<ComboBoxAttachment> oversamplingAttachment;
 
+    // Oversampling filter mode (linear phase FIR or low latency IIR)
+    juce::ComboBox oversamplingModeComboBox;
+    std::unique_ptr<ComboBoxAttachment> oversamplingModeAttachment;
+
+    // Fast math toggle
+    juce::ToggleButton fastMathButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> fastMathAttachment;
+
+    // Multi-core processing toggle
+    juce::ToggleButton multiCoreButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> multiCoreAttachment;
+
+    // Sleep-when-silent toggle, and a label that shows while the instance is asleep
+    juce::ToggleButton sleepWhenSilentButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> sleepWhenSilentAttachment;
+    juce::Label sleepingLabel;
+
     // Preset management components
     juce::ComboBox presetComboBox;
     juce::TextButton savePresetButton;
@@ -106,6 +136,7 @@ private:
     //juce::Slider limiterThresholdSlider;
     //juce::Slider limiterReleaseSlider;
     juce::ToggleButton limiterEnabledButton;
+    juce::ToggleButton limiterLinkButton;
 
     juce::Label limiterThresholdLabel;
     juce::Label limiterReleaseLabel;
@@ -113,6 +144,13 @@ private:
     std::unique_ptr<SliderAttachment> limiterThresholdAttachment;
     std::unique_ptr<SliderAttachment> limiterReleaseAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> limiterEnabledAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> limiterLinkAttachment;
+
+    // Momentary, short-term and integrated loudness and the true peak of the output
+    juce::Label loudnessLabel;
+
+    // Spectra before and after the distortion. The analyser only runs while this editor is open
+    SpectrumDisplay spectrumDisplay;
 
     // Gain controls
     //juce::Slider inputGainSlider;
@@ -130,6 +168,10 @@ private:
     LevelMeter outputLevelMeterL;
     LevelMeter outputLevelMeterR;
 
+    // Meter ballistics, worked out here from the processor's meter frames
+    Metering::Ballistics meterBallistics;
+    double lastMeterUpdateTime = 0.0;
+
     juce::Label inputMeterLabel;
     juce::Label outputMeterLabel;
      
@@ -145,6 +187,36 @@ private:
     juce::Label stereoWidthLabel;
     std::unique_ptr<SliderAttachment> stereoWidthAttachment;
 
+    // Which channel pairs the width applies to
+    juce::ComboBox widthPairsComboBox;
+    std::unique_ptr<ComboBoxAttachment> widthPairsAttachment;
+
+    // Multiband mode: the band count and the crossover frequencies between the bands
+    juce::ComboBox numBandsComboBox;
+    std::unique_ptr<ComboBoxAttachment> numBandsAttachment;
+
+    std::array<CustomSlider, Multiband::maxCrossovers> crossoverSliders;
+    std::array<std::unique_ptr<SliderAttachment>, Multiband::maxCrossovers> crossoverAttachments;
+
+    // One column of controls per band
+    struct BandControls
+    {
+        juce::ToggleButton bypassButton;
+        juce::ComboBox typeComboBox;
+        CustomSlider driveSlider;
+        CustomSlider mixSlider;
+
+        std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> bypassAttachment;
+        std::unique_ptr<ComboBoxAttachment> typeAttachment;
+        std::unique_ptr<SliderAttachment> driveAttachment;
+        std::unique_ptr<SliderAttachment> mixAttachment;
+    };
+
+    std::array<BandControls, Multiband::maxBands> bandControls;
+
+    // Greys out the crossovers and bands the current band count doesn't use
+    void updateMultibandControls();
+
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NaniDistortionAudioProcessorEditor)
 };
\ No newline at end of file
@@ -1,6 +1,47 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+#if NANI_DETECT_AUDIO_THREAD_ALLOCATIONS
+// Replacement allocation functions used by the AllocationGuard debug mode.
+// They behave like the defaults but assert inside an AllocationGuard::ScopedNoAllocation.
+void* operator new(std::size_t size)
+{
+    AllocationGuard::checkAllocation();
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    AllocationGuard::checkAllocation();
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        AllocationGuard::checkAllocation();
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { operator delete(ptr); }
+#endif
+
 // The definition of the function is placed here, outside of the constructor.
 // It is correctly namespaced to the class.
 juce::AudioProcessorValueTreeState::ParameterLayout NaniDistortionAudioProcessor::createParameterLayout()
@@ -44,6 +85,17 @@ juce::AudioProcessorValueTreeState::ParameterLayout NaniDistortionAudioProcessor
         0.0f
     ));
 
+    // Sample rate reduction options: band-limit the input, and grab it at exact fractional positions
+    params.push_back(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID{ "decimatorBandLimited", 1 },
+        "Band-Limited Decimation",
+        false)); // Default to the classic aliasing sound
+
+    params.push_back(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID{ "decimatorFractional", 1 },
+        "Fractional Decimation",
+        false)); // Default to grabbing the nearest sample
+
     params.push_back(std::make_unique<juce::AudioParameterFloat>(
         juce::ParameterID{ "mix", 1 },
         "Mix",
@@ -61,6 +113,31 @@ juce::AudioProcessorValueTreeState::ParameterLayout NaniDistortionAudioProcessor
 
     params.push_back(std::make_unique<juce::AudioParameterChoice>(
         juce::ParameterID{ "distortionType", 1 }, "Distortion Type", distortionTypeChoices, 0)); // Default to Soft Clip
+
+    // Fast math: cheaper tanh/sin approximations in the shapers (see FastMath.h for the error bounds)
+    params.push_back(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID{ "fastMath", 1 },
+        "Fast Math",
+        false)); // Default to the accurate curves
+
+    // Anti-aliasing: ADAA versions of the Soft Clip, Hard Clip and Foldback shapers (see AdaaShapers.h)
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{ "antiAliasing", 1 },
+        "Anti-Aliasing",
+        juce::StringArray("Off", "ADAA 1st Order", "ADAA 2nd Order"),
+        0)); // Default to off, so existing sessions sound the same
+
+    // Multi-core: spread the channels of large (oversampled) blocks over worker threads (see WorkerPool.h)
+    params.push_back(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID{ "multiCore", 1 },
+        "Multi-Core Processing",
+        false)); // Default to off; hosts usually spread tracks over the cores already
+
+    // Sleep when silent: skip all processing once the input has been silent for longer than the tail (see SilenceDetector.h)
+    params.push_back(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID{ "sleepWhenSilent", 1 },
+        "Sleep When Silent",
+        true)); // Default to on; a sleeping instance sounds exactly like one processing silence
     
     // <<< ADD THE NEW FILTER PARAMETERS
 
@@ -95,6 +172,13 @@ juce::AudioProcessorValueTreeState::ParameterLayout NaniDistortionAudioProcessor
         juce::StringArray("Off", "2x", "4x", "8x", "16x"),
         1)); // Default to 2x
 
+    // Linear phase (FIR) filters have the cleaner response, low latency (IIR) ones a delay of only a few samples
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{ "oversamplingMode", 1 },
+        "Oversampling Mode",
+        juce::StringArray("Linear Phase", "Low Latency"),
+        0)); // Default to linear phase
+
 	// <<< ADD THE NEW LIMITER PARAMETERS
     params.push_back(std::make_unique<juce::AudioParameterFloat>(
         juce::ParameterID{ "limiterThreshold", 1 },
@@ -113,6 +197,12 @@ juce::AudioProcessorValueTreeState::ParameterLayout NaniDistortionAudioProcessor
         "Limiter Enabled",
         true)); // Default to enabled
 
+    // Linked, every channel gets the gain reduction of the loudest one, so the image stays put
+    params.push_back(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID{ "limiterLink", 1 },
+        "Limiter Stereo Link",
+        true));
+
 	// <<< ADD THE NEW INPUT AND OUTPUT GAIN PARAMETERS
     params.push_back(std::make_unique<juce::AudioParameterFloat>(
         juce::ParameterID{ "inputGain", 1 },
@@ -139,6 +229,47 @@ juce::AudioProcessorValueTreeState::ParameterLayout NaniDistortionAudioProcessor
         juce::NormalisableRange<float>(0.0f, 2.0f, 0.01f),
         1.0f)); // Default to 1.0 (normal stereo)
 
+    // On surround layouts, whether the width applies to the front left/right only or to every pair
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{ "widthPairs", 1 },
+        "Width Channels",
+        juce::StringArray("Front", "All Pairs"),
+        0)); // Default to the front pair
+
+    // Multiband mode: the signal is split by Linkwitz-Riley crossovers and each band is
+    // distorted with its own drive, type and mix (see Multiband.h)
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{ "numBands", 1 },
+        "Bands",
+        juce::StringArray("1 Band", "2 Bands", "3 Bands", "4 Bands"),
+        0)); // Default to a single band, the classic full-range distortion
+
+    const float defaultCrossovers[] = { 150.0f, 1000.0f, 5000.0f };
+
+    for (int crossover = 0; crossover < Multiband::maxCrossovers; ++crossover)
+        params.push_back(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID{ getCrossoverParameterID(crossover), 1 },
+            "Crossover " + juce::String(crossover + 1),
+            juce::NormalisableRange<float>(20.0f, 20000.0f, 1.0f, 0.25f),
+            defaultCrossovers[crossover]));
+
+    for (int band = 0; band < Multiband::maxBands; ++band)
+    {
+        const auto name = "Band " + juce::String(band + 1) + " ";
+
+        params.push_back(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID{ getBandParameterID(band, "Drive"), 1 }, name + "Drive", 0.0f, 2.0f, 1.0f));
+
+        params.push_back(std::make_unique<juce::AudioParameterChoice>(
+            juce::ParameterID{ getBandParameterID(band, "Type"), 1 }, name + "Type", distortionTypeChoices, 0));
+
+        params.push_back(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID{ getBandParameterID(band, "Mix"), 1 }, name + "Mix", 0.0f, 1.0f, 1.0f));
+
+        params.push_back(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID{ getBandParameterID(band, "Bypass"), 1 }, name + "Bypass", false));
+    }
+
 
     return { params.begin(), params.end() };
 }
@@ -149,17 +280,29 @@ NaniDistortionAudioProcessor::NaniDistortionAudioProcessor()
     : AudioProcessor(BusesProperties()
         .withInput("Input", juce::AudioChannelSet::stereo(), true)
         .withOutput("Output", juce::AudioChannelSet::stereo(), true)),
-      treeState(*this, nullptr, "PARAMETERS", NaniDistortionAudioProcessor::createParameterLayout())
+      treeState(*this, nullptr, "PARAMETERS", NaniDistortionAudioProcessor::createParameterLayout()),
+      parameters(treeState)
 #endif
 {
+    treeState.addParameterListener("multiCore", this);
 }
 
-NaniDistortionAudioProcessor::~NaniDistortionAudioProcessor() {}
+NaniDistortionAudioProcessor::~NaniDistortionAudioProcessor()
+{
+    treeState.removeParameterListener("multiCore", this);
+    cancelPendingUpdate();
+}
 
 const juce::String NaniDistortionAudioProcessor::getName() const { return JucePlugin_Name; }
 bool NaniDistortionAudioProcessor::acceptsMidi() const { return false; }
 bool NaniDistortionAudioProcessor::producesMidi() const { return false; }
-double NaniDistortionAudioProcessor::getTailLengthSeconds() const { return 0.0; }
+double NaniDistortionAudioProcessor::getTailLengthSeconds() const { return calculateTailSeconds(parameters.load()); }
+
+// Any layout from mono up to 16 channels, as long as the output matches the input
+bool NaniDistortionAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
+{
+    return ChannelLayout::isSupported(layouts);
+}
 int NaniDistortionAudioProcessor::getNumPrograms() { return 1; }
 int NaniDistortionAudioProcessor::getCurrentProgram() { return 0; }
 void NaniDistortionAudioProcessor::setCurrentProgram(int index) {}
@@ -172,95 +315,90 @@ juce::AudioProcessorValueTreeState& NaniDistortionAudioProcessor::getValueTreeSt
     return treeState;
 }
 
-void NaniDistortionAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
+template <typename SampleType>
+void NaniDistortionAudioProcessor::DspState<SampleType>::prepare(double sampleRate, int samplesPerBlock, int numChannels,
+                                                                 const ParameterSnapshot& params)
 {
-    // Create all possible oversampling objects
-    oversamplers.clear();
-
-    // No oversampling (1x)
-    oversamplers.push_back(nullptr);
+    // Only build the oversampler the current settings need; others are made on demand
+    oversampling.prepare(numChannels, samplesPerBlock, sampleRate, OversamplerManager<SampleType>::getKey(params));
 
-    // 2x oversampling
-    oversamplers.push_back(std::make_unique<juce::dsp::Oversampling<float>>(
-        getTotalNumOutputChannels(),
-        1, // 2^1 = 2x
-        juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple,
-        true
-    ));
-
-    // 4x oversampling
-    oversamplers.push_back(std::make_unique<juce::dsp::Oversampling<float>>(
-        getTotalNumOutputChannels(),
-        2, // 2^2 = 4x
-        juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple,
-        true
-    ));
-
-    // 8x oversampling
-    oversamplers.push_back(std::make_unique<juce::dsp::Oversampling<float>>(
-        getTotalNumOutputChannels(),
-        3, // 2^3 = 8x
-        juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple,
-        true
-    ));
-
-    // 16x oversampling
-    oversamplers.push_back(std::make_unique<juce::dsp::Oversampling<float>>(
-        getTotalNumOutputChannels(),
-        4, // 2^4 = 16x
-        juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple,
-        true
-    ));
+    // Prepare a filter for every oversampling rate, plus the rest of the chain's state
+    chainState.prepare(sampleRate, samplesPerBlock, numChannels);
 
-    // Initialize all oversamplers
-    for (auto i = 1; i < oversamplers.size(); ++i) {
-        if (oversamplers[i]) {
-            oversamplers[i]->initProcessing(samplesPerBlock);
-            oversamplers[i]->reset();
-        }
-    }
-
-    // Get parameter pointers - this is the correct way to get atomic parameters
-    limiterThresholdParam = treeState.getRawParameterValue("limiterThreshold");
-    limiterReleaseParam = treeState.getRawParameterValue("limiterRelease");
-    limiterEnabledParam = treeState.getRawParameterValue("limiterEnabled");
-    inputGainParam = treeState.getRawParameterValue("inputGain");
-    outputGainParam = treeState.getRawParameterValue("outputGain");
-
-    // Get bypass parameter
-    bypassParam = treeState.getRawParameterValue("bypass");
+    // Same again for the outgoing path of an oversampler crossfade, so copying the state over never allocates
+    crossfadeChainState.prepare(sampleRate, samplesPerBlock, numChannels);
 
-    // Get stereo width parameter
-    stereoWidthParam = treeState.getRawParameterValue("stereoWidth");
-
-    // Prepare filter for the highest possible oversampling rate
-    juce::dsp::ProcessSpec spec;
-    spec.sampleRate = sampleRate * 16; // Maximum oversampling
-    spec.maximumBlockSize = samplesPerBlock * 16;
-    spec.numChannels = getTotalNumOutputChannels();
-
-    filter.prepare(spec);
-    filter.reset();
+    // Allocate everything the real-time path needs up front, so processBlock never has to
+    scratch.prepare(numChannels, samplesPerBlock);
+    bypassEngine.prepare(sampleRate, numChannels, samplesPerBlock);
+    dryAllpass.prepare(numChannels);
 
     // Prepare the limiter
-    juce::dsp::ProcessSpec limiterSpec;
-    limiterSpec.sampleRate = sampleRate;
-    limiterSpec.maximumBlockSize = samplesPerBlock;
-    limiterSpec.numChannels = getTotalNumOutputChannels();
+    limiter.prepare(sampleRate, samplesPerBlock, numChannels);
+}
 
-    limiter.prepare(limiterSpec);
-    limiter.reset();
+template <typename SampleType>
+void NaniDistortionAudioProcessor::DspState<SampleType>::release()
+{
+    oversampling.release();
+    chainState.release();
+    crossfadeChainState.release();
+    bypassEngine.release();
+    scratch.release();
+    dryAllpass.release();
+    limiter.release();
+}
+
+void NaniDistortionAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
+{
+    // Only the precision the host has picked is prepared; the other one holds no memory
+    const auto params = parameters.load();
+    floatState.release();
+    doubleState.release();
+
+    if (isUsingDoublePrecision())
+        doubleState.prepare(sampleRate, samplesPerBlock, getTotalNumOutputChannels(), params);
+    else
+        floatState.prepare(sampleRate, samplesPerBlock, getTotalNumOutputChannels(), params);
+
+    // There's no use for more workers than channels past the first, or than the other cores.
+    // They're only started if multi-core is on; otherwise it's left until it's switched on.
+    workers.release();
+    numWorkersWanted = juce::jmin(getTotalNumOutputChannels(), juce::SystemStats::getNumPhysicalCpus()) - 1;
+
+    if (params.multiCore)
+        workers.start(numWorkersWanted);
+
+    prepared = true;
+    samplePosition = 0;
+    maxChunkSize = juce::jmax(1, samplesPerBlock);
+
+    // Work out which channels the stereo width can pair up
+    widthPairs = ChannelLayout::findPairs(getChannelLayoutOfBus(false, 0));
+
+    // A new loudness measurement starts with every prepare
+    loudnessMeter.prepare(sampleRate, samplesPerBlock, getChannelLayoutOfBus(false, 0));
+    spectrumAnalyser.prepare(sampleRate);
+
+    silenceDetector.reset();
+    sleeping = false;
+    smoothers.reset(sampleRate, params);
+
+    // Report the latency of the current settings straight away
+    requiredLatency = isUsingDoublePrecision() ? calculateLatencySamples<double>(params)
+                                               : calculateLatencySamples<float>(params);
+    setLatencySamples(requiredLatency);
 }
 
 void NaniDistortionAudioProcessor::releaseResources() 
 {
-    for (auto& oversampler : oversamplers) {
-        if (oversampler) {
-            oversampler->reset();
-        }
-    }
-    oversamplers.clear();
-    filter.reset();
+    // An async update still pending mustn't start the workers again
+    prepared = false;
+
+    floatState.release();
+    doubleState.release();
+    workers.release();
+    loudnessMeter.release();
 }
 
 /*
@@ -379,317 +517,430 @@ void NaniDistortionAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer
 */
 // Source/Plugin-processor.cpp
 
-void NaniDistortionAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+void NaniDistortionAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
 {
-    juce::ScopedNoDenormals noDenormals;
+    processInChunks(buffer, false);
+}
 
-    // Check if bypassed
-    bool shouldBypass = bypassParam->load() > 0.5f;
+void NaniDistortionAudioProcessor::processBlockBypassed(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
+{
+    processInChunks(buffer, true);
+}
 
-    // Calculate input levels (before any processing)
-    for (int channel = 0; channel < buffer.getNumChannels() && channel < 2; ++channel)
-    {
-        // Apply level decay
-        inputLevels[channel] *= levelDecayRate;
+bool NaniDistortionAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
 
-        // Find the peak level in this buffer
-        float currentPeak = 0.0f;
+void NaniDistortionAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer&)
+{
+    processInChunks(buffer, false);
+}
 
-        // Check each sample and find the peak
-        auto* channelData = buffer.getReadPointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
-        {
-            float sample = std::abs(channelData[i]);
-            if (sample > currentPeak)
-                currentPeak = sample;
-        }
+void NaniDistortionAudioProcessor::processBlockBypassed(juce::AudioBuffer<double>& buffer, juce::MidiBuffer&)
+{
+    processInChunks(buffer, true);
+}
 
-        // Update the level if the new peak is higher
-        if (currentPeak > inputLevels[channel])
-            inputLevels[channel] = currentPeak;
-    }
+template <typename SampleType>
+void NaniDistortionAudioProcessor::processInChunks(juce::AudioBuffer<SampleType>& buffer, bool forceBypass)
+{
+    const int numSamples = buffer.getNumSamples();
 
-    // If bypassed, skip all processing and just update output levels
-    if (shouldBypass)
+    // The usual case: the host kept to the size it gave prepareToPlay
+    if (numSamples <= maxChunkSize || maxChunkSize <= 0)
     {
-        // When bypassed, output levels are the same as input levels
-        for (int channel = 0; channel < buffer.getNumChannels() && channel < 2; ++channel)
-        {
-            outputLevels[channel] = inputLevels[channel];
-        }
-
+        process(buffer, forceBypass);
         return;
     }
 
-    // Get parameters
-    const int oversamplingIndex = static_cast<int>(treeState.getRawParameterValue("oversamplingFactor")->load());
-    const float drive = treeState.getRawParameterValue("drive")->load();
-    const float bitDepth = treeState.getRawParameterValue("bitdepth")->load();
-    const float sampleRateReduction = treeState.getRawParameterValue("samplerate")->load();
-    const float mix = treeState.getRawParameterValue("mix")->load();
-    const float cutoff = treeState.getRawParameterValue("filterCutoff")->load();
-    const float resonance = treeState.getRawParameterValue("filterResonance")->load();
-    const auto filterType = static_cast<FilterType>(static_cast<int>(treeState.getRawParameterValue("filterType")->load()));
-    const auto filterRouting = static_cast<FilterRouting>(static_cast<int>(treeState.getRawParameterValue("filterRouting")->load()));
-    const auto distortionType = static_cast<DistortionType>(static_cast<int>(treeState.getRawParameterValue("distortionType")->load()));
+    for (int start = 0; start < numSamples; start += maxChunkSize)
+    {
+        // Refers to the host's memory, with the channel pointers kept inside the buffer
+        // object for up to 32 channels, so this doesn't allocate
+        juce::AudioBuffer<SampleType> chunk(buffer.getArrayOfWritePointers(), buffer.getNumChannels(),
+                                            start, juce::jmin(maxChunkSize, numSamples - start));
+        process(chunk, forceBypass);
+    }
+}
+
+juce::AudioProcessorParameter* NaniDistortionAudioProcessor::getBypassParameter() const
+{
+    return treeState.getParameter("bypass");
+}
 
-    // Get gain parameters
-    const float inputGain = juce::Decibels::decibelsToGain(inputGainParam->load());
-    const float outputGain = juce::Decibels::decibelsToGain(outputGainParam->load());
+template <typename SampleType>
+void NaniDistortionAudioProcessor::process(juce::AudioBuffer<SampleType>& buffer, bool forceBypass)
+{
+    juce::ScopedNoDenormals noDenormals;
 
-    // Get stereo width parameter
-    const float stereoWidth = stereoWidthParam->load();
+    auto& dsp = getDspState<SampleType>();
 
-    // Create dry buffer for mix
-    juce::AudioBuffer<float> dryBuffer;
-    if (mix < 1.0f) dryBuffer.makeCopyOf(buffer);
+    // Nothing below this point may allocate (checked in NANI_DETECT_AUDIO_THREAD_ALLOCATIONS builds)
+    AllocationGuard::ScopedNoAllocation noAllocation;
+
+    // Read every parameter once, so the whole block sees one consistent set of values
+    const auto params = parameters.load();
 
-    // Apply input gain
-    buffer.applyGain(inputGain);
+    // The smoothed parameters glide towards those values. They move on every block, even
+    // bypassed or asleep, so they're already in place when processing starts again.
+    const auto ramps = smoothers.next(params, buffer.getNumSamples());
 
-    // Apply stereo width before processing (if stereo)
-    if (buffer.getNumChannels() > 1 && stereoWidth != 1.0f)
+    // Ask for the oversampler these settings need. When a new one is ready the chain state is
+    // copied for the outgoing one, which keeps running until the crossfade is over.
+    if (dsp.oversampling.update(OversamplerManager<SampleType>::getKey(params)))
+        dsp.crossfadeChainState = dsp.chainState;
+
+    // Keep the latency reported to the host in line with the active oversampler
+    const int latency = calculateLatencySamples<SampleType>(params);
+    if (requiredLatency.exchange(latency) != latency)
+        triggerAsyncUpdate();
+
+    // Check if bypassed
+    bool shouldBypass = params.bypass || forceBypass;
+
+    // The input goes into the bypass delay line whether or not we're bypassed, so it's
+    // ready to fade to at any time. The Mix comes before the limiter, so its dry side
+    // leaves out the lookahead.
+    const int mixLatency = latency - dsp.limiter.getLatencySamples();
+    dsp.bypassEngine.pushInput(buffer, latency, mixLatency, shouldBypass);
+
+    // Start this block's meter frame; the readings are filled in by the passes that touch the buffer anyway
+    const int numMeteredChannels = juce::jmin(buffer.getNumChannels(), Metering::maxChannels);
+    meterFrame.timestamp = samplePosition;
+    meterFrame.numSamples = buffer.getNumSamples();
+    meterFrame.sampleRate = getSampleRate();
+    meterFrame.numChannels = numMeteredChannels;
+    samplePosition += buffer.getNumSamples();
+
+    const bool fullyBypassed = dsp.bypassEngine.isFullyBypassed();
+
+    // If fully bypassed, output the delayed input, skip all processing and just update the meters
+    if (fullyBypassed)
     {
-        applyStereoWidth(buffer, stereoWidth);
+        dsp.bypassEngine.copyDryTo(buffer);
+
+        // When bypassed, output levels are the same as input levels
+        GainStages::measure(buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples(),
+                            meterFrame.input.data(), numMeteredChannels);
+        meterFrame.output = meterFrame.input;
+        meterTransport.push(meterFrame);
+        loudnessMeter.addBlock(buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
+        // Nothing gets distorted, so the output goes in as both spectra
+        spectrumAnalyser.push(Spectrum::PreDistortion, buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
+        spectrumAnalyser.push(Spectrum::PostDistortion, buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
+        sleeping.store(false, std::memory_order_relaxed);
+        return;
     }
 
-    // Process with or without oversampling
-    if (oversamplingIndex == 0 || oversamplers.size() <= oversamplingIndex || !oversamplers[oversamplingIndex]) {
-        // No oversampling - process directly
-        processAudio(buffer, drive, bitDepth, sampleRateReduction,
-            filterType, filterRouting, cutoff, resonance, distortionType);
+    // Once the input has been silent for longer than everything can ring on for, the output
+    // is silent too, so skip the whole wet path. Not while a crossfade is under way, since
+    // the outgoing side of it may still be audible.
+    const bool mayIdle = params.sleepWhenSilent && !dsp.oversampling.isCrossfading() && !dsp.bypassEngine.isCrossfading();
+    const bool inputIsSilent = mayIdle && SilenceDetector::isSilent(buffer.getArrayOfReadPointers(), buffer.getNumChannels(),
+                                                                     buffer.getNumSamples(), calculateSmallSignalGain(params));
+    const int tailSamples = latency + (int)std::ceil(calculateTailSeconds(params) * getSampleRate());
+
+    if (silenceDetector.update(inputIsSilent, buffer.getNumSamples(), tailSamples))
+    {
+        buffer.clear();
+        meterFrame.input = {};
+        meterFrame.output = {};
+        meterTransport.push(meterFrame);
+        loudnessMeter.addSilence(buffer.getNumSamples());
+        // The spectra fall away as the silence goes through
+        spectrumAnalyser.push(Spectrum::PreDistortion, buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
+        spectrumAnalyser.push(Spectrum::PostDistortion, buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
+        sleeping.store(true, std::memory_order_relaxed);
+        return;
     }
-    else {
-        // With oversampling
-        juce::dsp::AudioBlock<float> block(buffer);
-        auto& oversampler = *oversamplers[oversamplingIndex];
 
-        // Upsample
-        auto oversampledBlock = oversampler.processSamplesUp(block);
+    sleeping.store(false, std::memory_order_relaxed);
+
+    // Input metering, input gain and stereo width in a single pass over the buffer
+    GainStages::processPreStage(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples(),
+                                ramps.inputGain, ramps.width,
+                                widthPairs.pairs.data(), params.widthPairs == AllPairs ? widthPairs.numPairs : widthPairs.numFrontPairs,
+                                meterFrame.input.data(), numMeteredChannels);
 
-        // Process the oversampled audio
-        processOversampledBlock(oversampledBlock, drive, bitDepth, sampleRateReduction,
-            filterType, filterRouting, cutoff, resonance, distortionType);
+    // The spectrum going into the distortion, after the input gain and width
+    spectrumAnalyser.push(Spectrum::PreDistortion, buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
 
-        // Downsample
-        oversampler.processSamplesDown(block);
+    // Nothing has run while we were bypassed or asleep, so start the wet path from a clean state
+    if (dsp.bypassEngine.isResuming() || silenceDetector.isWaking())
+    {
+        dsp.oversampling.resetActive();
+        dsp.chainState.reset();
+        dsp.dryAllpass.reset();
+        dsp.limiter.reset();
     }
 
-    // Apply mix
-    applyMix(buffer, dryBuffer, mix);
+    // The dry signal for the mix is the input delayed by the latency of the wet path up to
+    // the mix, so it lines up with the wet signal instead of comb filtering against it
+    const auto* dryBuffer = &dsp.bypassEngine.getMixDry();
 
-    // Apply output gain
-    buffer.applyGain(outputGain);
+    // In multiband mode it also goes through the crossover's allpasses, like the summed bands.
+    // The allpasses run even with the mix at 100%, so they're settled when it's turned down.
+    dsp.dryAllpass.setParameters(getSampleRate(), params.numBands, params.crossoverFrequencies);
 
-    // Apply limiter (if enabled)
-    if (limiterEnabledParam->load() > 0.5f)
+    if (params.numBands > 1)
     {
-        limiter.setThreshold(limiterThresholdParam->load());
-        limiter.setRelease(limiterReleaseParam->load() / 1000.0f);
+        auto& allpassedDry = dsp.scratch.copyDry(*dryBuffer, buffer.getNumSamples());
+
+        for (int channel = 0; channel < juce::jmin(allpassedDry.getNumChannels(), dsp.dryAllpass.getNumChannels()); ++channel)
+            dsp.dryAllpass.applyAllpass(channel, allpassedDry.getWritePointer(channel), buffer.getNumSamples());
 
-        juce::dsp::AudioBlock<float> block(buffer);
-        juce::dsp::ProcessContextReplacing<float> context(block);
-        limiter.process(context);
+        dryBuffer = &allpassedDry;
     }
 
-    // Calculate output levels (after all processing)
-    for (int channel = 0; channel < buffer.getNumChannels() && channel < 2; ++channel)
+    // While the oversampler is being switched, run the outgoing one on a copy of the input
+    const bool crossfading = dsp.oversampling.isCrossfading();
+
+    if (crossfading)
     {
-        // Apply level decay
-        outputLevels[channel] *= levelDecayRate;
+        auto outgoingBlock = dsp.scratch.copyForCrossfade(buffer);
+        processWet(outgoingBlock, dsp.oversampling.getOutgoing(), params, ramps, dsp.crossfadeChainState);
+    }
 
-        // Find the peak level in this buffer
-        float currentPeak = 0.0f;
+    // Process with or without oversampling
+    juce::dsp::AudioBlock<SampleType> block(buffer);
+    processWet(block, dsp.oversampling.getActive(), params, ramps, dsp.chainState);
+
+    if (crossfading)
+    {
+        const auto [startGain, endGain] = dsp.oversampling.advanceCrossfade(buffer.getNumSamples());
+        const auto& outgoing = dsp.scratch.getCrossfadeBuffer();
 
-        // Check each sample for clipping and find the peak
-        auto* channelData = buffer.getReadPointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
+        for (int channel = 0; channel < juce::jmin(buffer.getNumChannels(), outgoing.getNumChannels()); ++channel)
         {
-            float sample = std::abs(channelData[i]);
-            if (sample > currentPeak)
-                currentPeak = sample;
+            buffer.applyGainRamp(channel, 0, buffer.getNumSamples(), (SampleType)startGain, (SampleType)endGain);
+            buffer.addFromWithRamp(channel, 0, outgoing.getReadPointer(channel), buffer.getNumSamples(),
+                                   (SampleType)(1.0f - startGain), (SampleType)(1.0f - endGain));
         }
-
-        // Update the level if the new peak is higher
-        if (currentPeak > outputLevels[channel])
-            outputLevels[channel] = currentPeak;
     }
+
+    // And coming out of it, before the mix
+    spectrumAnalyser.push(Spectrum::PostDistortion, buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
+
+    // Mix and output gain in a single pass. The output is metered in the same pass when
+    // nothing changes the buffer afterwards; otherwise it's metered at the end.
+    const bool meterInPostStage = !params.limiterEnabled && !dsp.bypassEngine.isCrossfading();
+
+    GainStages::processPostStage(buffer.getArrayOfWritePointers(), buffer.getNumChannels(),
+                                 dryBuffer->getArrayOfReadPointers(), dryBuffer->getNumChannels(), buffer.getNumSamples(),
+                                 ramps.mix, ramps.outputGain, meterInPostStage ? meterFrame.output.data() : nullptr, numMeteredChannels);
+
+    // Apply limiter (if enabled). Its lookahead delay is in the reported latency either way,
+    // so switched off the signal still goes through the delay line.
+    dsp.limiter.setParameters(params.limiterThreshold, params.limiterRelease, params.limiterLink);
+    dsp.limiter.process(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples(), params.limiterEnabled);
+
+    // Fade between the processed and the delayed input while bypass is being switched
+    dsp.bypassEngine.applyCrossfade(buffer);
+
+    // Calculate output levels (after all processing)
+    if (!meterInPostStage)
+        GainStages::measure(buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples(),
+                            meterFrame.output.data(), numMeteredChannels);
+
+    // Hand the readings to the editor. If it isn't reading them, the frame is dropped.
+    meterTransport.push(meterFrame);
+
+    // The silence detector only lets the instance sleep once the output has died away too
+    float outputPeak = 0.0f;
+
+    for (int channel = 0; channel < numMeteredChannels; ++channel)
+        outputPeak = juce::jmax(outputPeak, meterFrame.output[(size_t)channel].peak);
+
+    silenceDetector.outputProcessed(outputPeak);
+
+    // And the output to the loudness meter
+    loudnessMeter.addBlock(buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
 }
 
-// Helper method to process audio without oversampling
-void NaniDistortionAudioProcessor::processAudio(juce::AudioBuffer<float>& buffer,
-    float drive, float bitDepth, float sampleRateReduction,
-    FilterType filterType, FilterRouting filterRouting,
-    float cutoff, float resonance, DistortionType distortionType)
+template <typename SampleType>
+int NaniDistortionAudioProcessor::calculateLatencySamples(const ParameterSnapshot& params) noexcept
 {
-    // Update filter settings
-    switch (filterType) {
-    case LowPass:  filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);  break;
-    case HighPass: filter.setType(juce::dsp::StateVariableTPTFilterType::highpass); break;
-    case BandPass: filter.setType(juce::dsp::StateVariableTPTFilterType::bandpass); break;
+    float latency = 0.0f;
+    float factor = 1.0f;
+
+    if (auto* oversampler = getDspState<SampleType>().oversampling.getActive())
+    {
+        latency += (float)oversampler->getLatencyInSamples();
+        factor = (float)oversampler->getOversamplingFactor();
     }
-    filter.setCutoffFrequency(cutoff);
-    filter.setResonance(resonance);
 
-    // Create context for filter
-    juce::dsp::AudioBlock<float> block(buffer);
-    juce::dsp::ProcessContextReplacing<float> context(block);
+    // ADAA adds its own delay at the processing rate. The multiband crossover adds none: it's
+    // minimum phase, and the dry signal goes through its allpasses instead of being delayed.
+    if (ProcessingChain::usesAdaa(params))
+        latency += (float)Adaa::Waveshaper::getLatencyInSamples((Adaa::Order)juce::jlimit(0, 2, params.antiAliasing)) / factor;
 
-    // Apply pre-distortion filter if needed
-    if (filterRouting == FilterRouting::Pre) {
-        filter.process(context);
-    }
+    // The limiter's lookahead, at the base rate
+    return juce::roundToInt(latency) + getDspState<SampleType>().limiter.getLatencySamples();
+}
 
-    // Apply distortion
-    for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
-        auto* channelData = buffer.getWritePointer(channel);
-        for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-            float wetSample = channelData[sample];
-            wetSample = bitCrush(wetSample, (int)bitDepth);
-            float downsampleFactor = 1.0f + (sampleRateReduction * 15.0f);
-            wetSample = downsample(wetSample, downsampleFactor);
-            wetSample = waveshaper(wetSample, drive, distortionType);
-            channelData[sample] = wetSample;
+float NaniDistortionAudioProcessor::calculateSmallSignalGain(const ParameterSnapshot& params) noexcept
+{
+    // The shaper's slope at zero. In multiband mode bypassed bands go through untouched, the
+    // others through their own shapers.
+    float shaperGain = WaveshaperKernels::getSmallSignalGain(params.drive, params.distortionType);
+
+    if (params.numBands > 1)
+    {
+        shaperGain = 1.0f;
+
+        for (int band = 0; band < params.numBands; ++band)
+        {
+            const auto& settings = params.bands[(size_t)band];
+
+            if (!settings.bypass)
+                shaperGain = juce::jmax(shaperGain, WaveshaperKernels::getSmallSignalGain(settings.drive, settings.type));
         }
     }
 
-    // Apply post-distortion filter if needed
-    if (filterRouting == FilterRouting::Post) {
-        filter.process(context);
-    }
+    // The width can put up to (1 + width) / 2 of one side into the other's channel, and the
+    // filter's resonant peak is about its Q. The mix can't be louder than the louder of its
+    // wet and dry sides, and the limiter only ever turns things down.
+    const float widthGain = juce::jmax(1.0f, (1.0f + params.stereoWidth) * 0.5f);
+    const float resonanceGain = juce::jmax(1.0f, params.filterResonance);
+
+    return params.inputGain * widthGain * juce::jmax(1.0f, shaperGain) * resonanceGain * params.outputGain;
 }
 
-// Helper method to process oversampled audio block
-void NaniDistortionAudioProcessor::processOversampledBlock(juce::dsp::AudioBlock<float>& oversampledBlock,
-    float drive, float bitDepth, float sampleRateReduction,
-    FilterType filterType, FilterRouting filterRouting,
-    float cutoff, float resonance, DistortionType distortionType)
+double NaniDistortionAudioProcessor::calculateTailSeconds(const ParameterSnapshot& params) const noexcept
 {
-    // Update filter settings
-    switch (filterType) {
-    case LowPass:  filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);  break;
-    case HighPass: filter.setType(juce::dsp::StateVariableTPTFilterType::highpass); break;
-    case BandPass: filter.setType(juce::dsp::StateVariableTPTFilterType::bandpass); break;
-    }
-    filter.setCutoffFrequency(cutoff);
-    filter.setResonance(resonance);
+    // How long a 2nd-order section takes to ring down by 120 dB: its envelope falls as
+    // exp(-2 pi f t / 2Q) for any Q above 0.5
+    auto ringTime = [](double frequency, double q)
+    {
+        return std::log(1.0e6) * 2.0 * q / (juce::MathConstants<double>::twoPi * juce::jmax(frequency, 10.0));
+    };
 
-    // Create context for filter
-    juce::dsp::ProcessContextReplacing<float> context(oversampledBlock);
+    // The filter: up to a couple of seconds at 20 Hz and full resonance
+    double seconds = ringTime(params.filterCutoff, params.filterResonance);
 
-    // Apply pre-distortion filter if needed
-    if (filterRouting == FilterRouting::Pre) {
-        filter.process(context);
-    }
+    // In multiband mode, each band goes through up to three Butterworth sections per crossover
+    for (int k = 0; k < params.numBands - 1; ++k)
+        seconds += 3.0 * ringTime(params.crossoverFrequencies[(size_t)k], 1.0 / juce::MathConstants<double>::sqrt2);
 
-    // Apply distortion
-    for (int channel = 0; channel < oversampledBlock.getNumChannels(); ++channel) {
-        auto* channelData = oversampledBlock.getChannelPointer(channel);
-        for (int sample = 0; sample < oversampledBlock.getNumSamples(); ++sample) {
-            float wetSample = channelData[sample];
-            wetSample = bitCrush(wetSample, (int)bitDepth);
-            float downsampleFactor = 1.0f + (sampleRateReduction * 15.0f);
-            wetSample = downsample(wetSample, downsampleFactor);
-            wetSample = waveshaper(wetSample, drive, distortionType);
-            channelData[sample] = wetSample;
-        }
-    }
+    // The sample-and-hold can repeat a value for up to 16 samples
+    seconds += 16.0 / juce::jmax(1.0, getSampleRate());
 
-    // Apply post-distortion filter if needed
-    if (filterRouting == FilterRouting::Post) {
-        filter.process(context);
-    }
+    // The limiter makes no sound of its own once the input stops, but its gain has to have
+    // recovered (seven release time constants, 0.1%) before it can be reset without a jump
+    if (params.limiterEnabled)
+        seconds = juce::jmax(seconds, 7.0 * params.limiterRelease / 1000.0);
+
+    return seconds;
 }
 
-// Helper method to apply mix
-void NaniDistortionAudioProcessor::applyMix(juce::AudioBuffer<float>& buffer,
-    const juce::AudioBuffer<float>& dryBuffer,
-    float mix)
+void NaniDistortionAudioProcessor::handleAsyncUpdate()
 {
-    if (mix == 0.0f) {
-        // If mix is 0%, just copy the dry signal back
-        buffer.copyFrom(0, 0, dryBuffer, 0, 0, buffer.getNumSamples());
-        if (buffer.getNumChannels() > 1)
-            buffer.copyFrom(1, 0, dryBuffer, 1, 0, buffer.getNumSamples());
-    }
-    else if (mix < 1.0f) {
-        // For partial mix, apply gain to the wet signal
-        buffer.applyGain(mix);
-        // And add the dry signal with its gain
-        buffer.addFrom(0, 0, dryBuffer, 0, 0, buffer.getNumSamples(), (1.0f - mix));
-        if (buffer.getNumChannels() > 1)
-            buffer.addFrom(1, 0, dryBuffer, 1, 0, buffer.getNumSamples(), (1.0f - mix));
-    }
-    // If mix is 1.0f, we do nothing
+    setLatencySamples(requiredLatency.load());
+
+    // Does nothing if the workers are already running, or if the resources have been released
+    if (prepared && parameters.load().multiCore)
+        workers.start(numWorkersWanted);
 }
 
-float NaniDistortionAudioProcessor::bitCrush(float sample, int bits)
+// Automation can call this on the audio thread, so the workers are started from handleAsyncUpdate()
+void NaniDistortionAudioProcessor::parameterChanged(const juce::String&, float newValue)
 {
-    if (bits >= 16) return sample;
-    float steps = powf(2.0f, (float)bits);
-    return roundf(sample * steps) / steps;
+    if (newValue >= 0.5f)
+        triggerAsyncUpdate();
 }
 
-float NaniDistortionAudioProcessor::downsample(float sample, float factor)
+// Helper method to run the wet path, with or without oversampling
+template <typename SampleType>
+void NaniDistortionAudioProcessor::processWet(juce::dsp::AudioBlock<SampleType>& block, juce::dsp::Oversampling<SampleType>* oversampler,
+                                              const ParameterSnapshot& params, const ParameterRamps::BlockRamps& ramps,
+                                              ProcessingChain::State<SampleType>& state)
 {
-    if (factor <= 1.0f)
-    {
-        downsampleCounter = 0.0f; // Reset state when effect is off
-        downsamplePhase = sample;
-        return sample;
+    if (oversampler == nullptr) {
+        // No oversampling - process directly
+        processAudio(block, 0, params, ramps, state);
+        return;
     }
 
-    downsampleCounter += 1.0f;
-    if (downsampleCounter >= factor)
-    {
-        downsampleCounter -= factor;
-        downsamplePhase = sample;
-    }
-    return downsamplePhase;
-}
+    // Upsample
+    auto oversampledBlock = oversampler->processSamplesUp(block);
 
-// Source/PluginProcessor.cpp
+    // Process the oversampled audio
+    processAudio(oversampledBlock, FilterBank<SampleType>::getRateIndex(oversampler->getOversamplingFactor()), params, ramps, state);
 
-float NaniDistortionAudioProcessor::waveshaper(float sample, float drive, DistortionType type)
+    // Downsample
+    oversampler->processSamplesDown(block);
+}
+
+// Helper method to run the chain on a block at the given rate
+template <typename SampleType>
+void NaniDistortionAudioProcessor::processAudio(juce::dsp::AudioBlock<SampleType>& block, int rateIndex, const ParameterSnapshot& params,
+                                                const ParameterRamps::BlockRamps& ramps, ProcessingChain::State<SampleType>& state)
 {
-    // The gain is used differently by each algorithm
-    float gain = 1.0f + drive * 9.0f;
+    // Update filter settings (only recalculated when they change)
+    auto& filter = state.filters.getFilter(rateIndex);
+    filter.setParameters(params.filterType, params.filterCutoff, params.filterResonance);
+
+    // The crossover runs at the processing rate, so its coefficients depend on the rate too
+    state.crossover.setParameters(getSampleRate() * (1 << rateIndex), params.numBands, params.crossoverFrequencies);
+
+    // Run the chain compiled for this block's distortion type, active stages and filter routing
+    ProcessingChain::Context<SampleType> context { filter, state.decimator, state.adaa, shaperImplementation,
+                                                   state.crossover, getDspState<SampleType>().scratch.getBandBuffer() };
+    const auto chain = ProcessingChain::select<SampleType>(params);
+
+    const bool channelsIndependent = filter.beginBlock();
+    const int numChannels = (int)block.getNumChannels();
+
+    // With the drive and band settings still, the chain takes the whole block in one go, a
+    // cache-sized tile at a time. Otherwise it goes through in sub-blocks of subBlockSize
+    // samples at the base rate, each with the values the ramps have at its middle.
+    const bool chainMoving = ramps.isChainMoving();
+    const int subBlockSize = ParameterRamps::subBlockSize << rateIndex;
+    const float baseRateScale = 1.0f / (float)(1 << rateIndex);
+    const int tile = getTileSize();
+
+    auto runChain = [&](juce::dsp::AudioBlock<SampleType>& part, int firstChannel)
+    {
+        if (!chainMoving)
+        {
+            ProcessingChain::processTiled(chain, part, firstChannel, params, context, tile);
+            return;
+        }
+
+        auto subParams = params;
+        const int numSamples = (int)part.getNumSamples();
+
+        for (int start = 0; start < numSamples; start += subBlockSize)
+        {
+            const int length = juce::jmin(subBlockSize, numSamples - start);
+            ramps.applyTo(subParams, ((float)start + 0.5f * (float)length) * baseRateScale);
+
+            auto subBlock = part.getSubBlock((size_t)start, (size_t)length);
+            ProcessingChain::processTiled(chain, subBlock, firstChannel, subParams, context, tile);
+        }
+    };
+
+    // Big blocks can have their channels spread over the worker threads. Every band is work
+    // on its channel's task, so the bands count towards the size of the task.
+    if (params.multiCore && channelsIndependent
+        && workers.isWorthSplitting(numChannels, (int)block.getNumSamples() * params.numBands))
+    {
+        auto processChannel = [&](int channel)
+        {
+            auto channelBlock = block.getSingleChannelBlock((size_t)channel);
+            runChain(channelBlock, channel);
+        };
 
-    switch (type)
+        // Returns once every channel is done, so the block is complete before it's downsampled
+        workers.run(numChannels, processChannel);
+    }
+    else
     {
-        case SoftClip:
-            // Our original smooth tanh curve
-            return std::tanh(sample * gain);
-
-        case HardClip:
-            // An aggressive, squared-off digital distortion
-            return std::clamp(sample * gain, -1.0f, 1.0f);
-
-        case Foldback:
-            // Folds the waveform back on itself, creating inharmonic tones
-            // The sine function is a great way to do this
-            return std::sin(sample * gain);
-
-        case BitGlitch:
-            // This is the "Nani" special. It treats the float's memory as an
-            // integer and flips some of its bits, creating digital artifacts.
-            {
-                // Reinterpret the memory address of the float as an integer pointer
-                int32_t* p = reinterpret_cast<int32_t*>(&sample);
-                
-                // Use bitwise XOR with a mask. The drive knob can control the mask.
-                // This creates very different glitches at different drive levels.
-                int32_t mask = static_cast<int32_t>(drive * 1000.0f) << 12;
-                *p ^= mask;
-                
-                // Make sure we don't return an infinitely large number
-                return std::clamp(sample, -1.0f, 1.0f);
-            }
-        
-        default:
-            // Fallback to the default in case of an error
-            return std::tanh(sample * gain);
+        runChain(block, 0);
     }
+
+    filter.endBlock();
 }
 
 // Helper methods for preset management
@@ -810,46 +1061,25 @@ void NaniDistortionAudioProcessor::setStateInformation(const void* data, int siz
             treeState.replaceState(juce::ValueTree::fromXml(*xmlState));
 }
 
-// Add these implementations to your PluginProcessor.cpp file:
-float NaniDistortionAudioProcessor::getInputLevel(int channel) const
+juce::String NaniDistortionAudioProcessor::getMemoryReport() const
 {
-    if (channel >= 0 && channel < 2)
-        return inputLevels[channel];
-    return 0.0f;
-}
+    auto toKilobytes = [](size_t bytes) { return juce::String((double)bytes / 1024.0, 1) + " KB"; };
 
-float NaniDistortionAudioProcessor::getOutputLevel(int channel) const
-{
-    if (channel >= 0 && channel < 2)
-        return outputLevels[channel];
-    return 0.0f;
-}
-
-// Apply stereo width to the audio buffer
-void NaniDistortionAudioProcessor::applyStereoWidth(juce::AudioBuffer<float>& buffer, float width)
-{
-    // Only process if we have a stereo buffer
-    if (buffer.getNumChannels() < 2)
-        return;
-
-    // Get pointers to the left and right channels
-    float* leftChannel = buffer.getWritePointer(0);
-    float* rightChannel = buffer.getWritePointer(1);
-
-    // Process each sample
-    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    auto report = [&](const auto& state)
     {
-        // Convert to mid/side
-        float mid = (leftChannel[i] + rightChannel[i]) * 0.5f;
-        float side = (rightChannel[i] - leftChannel[i]) * 0.5f;
-
-        // Apply width to the side signal
-        side *= width;
-
-        // Convert back to left/right
-        leftChannel[i] = mid - side;
-        rightChannel[i] = mid + side;
-    }
+        return "Oversamplers: " + juce::String(state.oversampling.getNumOversamplersAlive()) + " alive, "
+             + toKilobytes(state.oversampling.getMemoryUsage())
+             + " (all of them up front: " + toKilobytes(state.oversampling.estimateMemoryUsageOfAll()) + ")"
+             + ", chain state: " + toKilobytes(state.chainState.getMemoryUsage())
+             + " (crossfade copy: " + toKilobytes(state.crossfadeChainState.getMemoryUsage()) + ")"
+             + ", scratch buffers: " + toKilobytes(state.scratch.getMemoryUsage())
+             + ", dry delay: " + toKilobytes(state.bypassEngine.getMemoryUsage())
+             + ", limiter: " + toKilobytes(state.limiter.getMemoryUsage());
+    };
+
+    return (isUsingDoublePrecision() ? "Double precision. " + report(doubleState) : report(floatState))
+         + ", loudness meter: " + toKilobytes(loudnessMeter.getMemoryUsage())
+         + ", spectrum analyser: " + toKilobytes(spectrumAnalyser.getMemoryUsage());
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
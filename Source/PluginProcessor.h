@@ -3,15 +3,26 @@
 #include <JuceHeader.h>
 // Add these includes at the top of your file if they're not already there
 #include <juce_dsp/juce_dsp.h>
-
-// <<< ADD THESE ENUMS for clarity and type safety
-enum FilterType { LowPass, HighPass, BandPass };
-enum FilterRouting { Pre, Post };
-
-// <<< ADD THIS ENUM FOR OUR NEW DISTORTION TYPES
-enum DistortionType { SoftClip, HardClip, Foldback, BitGlitch };
-
-class NaniDistortionAudioProcessor : public juce::AudioProcessor
+#include "ScratchMemory.h"
+#include "AllocationGuard.h"
+#include "ParameterSnapshot.h"
+#include "WaveshaperKernels.h"
+#include "ProcessingChain.h"
+#include "OversamplerManager.h"
+#include "BypassEngine.h"
+#include "GainStages.h"
+#include "MeterTransport.h"
+#include "ChannelLayout.h"
+#include "Multiband.h"
+#include "WorkerPool.h"
+#include "SilenceDetector.h"
+#include "ParameterRamps.h"
+#include "TruePeakLimiter.h"
+#include "LoudnessMeter.h"
+#include "SpectrumAnalyser.h"
+
+class NaniDistortionAudioProcessor : public juce::AudioProcessor, private juce::AsyncUpdater,
+                                     private juce::AudioProcessorValueTreeState::Listener
 {
 public:
     NaniDistortionAudioProcessor();
@@ -19,7 +30,20 @@ public:
 
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
+
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+
+    // The double precision path is the same processing compiled for double; hosts that
+    // ask for it get the whole chain, oversamplers and limiter included, in double
+    bool supportsDoublePrecisionProcessing() const override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    void processBlockBypassed(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    // Hosts that bypass natively drive our own bypass parameter, so they get the same
+    // latency-compensated crossfade
+    juce::AudioProcessorParameter* getBypassParameter() const override;
 
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -46,9 +70,26 @@ public:
     juce::String getCurrentPresetName() const { return currentPresetName; }
     void setCurrentPresetName(const juce::String& name) { currentPresetName = name; }
 
-    // Level meter methods
-    float getInputLevel(int channel) const;
-    float getOutputLevel(int channel) const;
+    // Meter readings, one frame per block. Only the editor reads from it.
+    Metering::Transport& getMeterTransport() noexcept { return meterTransport; }
+
+    // Loudness and true peak of the output (see LoudnessMeter.h). Readable from any thread.
+    Loudness::Meter& getLoudnessMeter() noexcept { return loudnessMeter; }
+
+    // Spectra going into and coming out of the distortion. The editor starts and stops it.
+    Spectrum::Analyser& getSpectrumAnalyser() noexcept { return spectrumAnalyser; }
+
+    // Whether the last block was skipped because the input had been silent for longer than the tail
+    bool isSleeping() const noexcept { return sleeping.load(std::memory_order_relaxed); }
+
+    // How many samples (at the processing rate) go through the whole chain at a time, so they
+    // stay in cache from one stage to the next. A multiple of 4; 0 runs each stage over the
+    // whole block. The output is the same either way.
+    void setTileSize(int samples) noexcept { tileSize.store(juce::jmax(0, samples / 4 * 4), std::memory_order_relaxed); }
+    int getTileSize() const noexcept { return tileSize.load(std::memory_order_relaxed); }
+
+    // How much memory this instance is holding on to, for checking per-instance costs
+    juce::String getMemoryReport() const;
     
     // Public access to the state for the editor
     juce::AudioProcessorValueTreeState& getValueTreeState();
@@ -60,25 +101,72 @@ public:
 private:
     // The AudioProcessorValueTreeState must be declared before any parameter pointers
     juce::AudioProcessorValueTreeState treeState;
-    
-    // <<< CHANGE THIS
-    // We must use a pointer because the constructor needs parameters
-    // that we only get in prepareToPlay.
-    // Replace the single oversampling member with a vector of oversamplers
-    std::vector<std::unique_ptr<juce::dsp::Oversampling<float>>> oversamplers;
-    
-    // <<< ADD THE FILTER OBJECT
-    juce::dsp::StateVariableTPTFilter<float> filter;
 
-    // DSP processing chain
-    float downsampleCounter = 0.0f;
-    float downsamplePhase = 0.0f;
+    // Raw parameter values, bound once from treeState so processBlock can read them all in one go
+    ParameterBindings parameters;
+
+    // Everything on the real-time path that holds audio, for one sample type. Only the one
+    // for the precision the host is using gets prepared; the other stays empty.
+    template <typename SampleType>
+    struct DspState
+    {
+        // Only the oversampler the settings call for exists; changes are built in the
+        // background and crossfaded in (see OversamplerManager.h)
+        OversamplerManager<SampleType> oversampling;
+
+        // The filters (one per processing rate), sample rate reducer and ADAA history
+        ProcessingChain::State<SampleType> chainState;
+
+        // While the oversampler is being switched, the outgoing one keeps running for the
+        // crossfade, with its own copy of the chain state
+        ProcessingChain::State<SampleType> crossfadeChainState;
+
+        // Preallocated buffers for the real-time path
+        ScratchMemory<SampleType> scratch;
+
+        // Lookahead true-peak limiter; its delay is part of the latency even when it's off
+        TruePeakLimiter<SampleType> limiter;
+
+        // Latency-compensated, crossfaded bypass
+        BypassEngine<SampleType> bypassEngine;
+
+        // In multiband mode the bands sum to the input through the crossover's allpasses; the
+        // dry signal for the mix goes through the same ones, at the base rate, to stay in phase
+        Multiband::Crossover<SampleType> dryAllpass;
+
+        void prepare(double sampleRate, int samplesPerBlock, int numChannels, const ParameterSnapshot& params);
+        void release();
+    };
+
+    DspState<float> floatState;
+    DspState<double> doubleState;
+
+    template <typename SampleType>
+    DspState<SampleType>& getDspState() noexcept
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleState;
+        else
+            return floatState;
+    }
+
+    // Latency reporting: the audio thread works out what the host should compensate for,
+    // and the message thread passes it on, since setLatencySamples() notifies the host
+    template <typename SampleType>
+    int calculateLatencySamples(const ParameterSnapshot& params) noexcept;
+    void handleAsyncUpdate() override;
+    std::atomic<int> requiredLatency { 0 };
+
+    // How long the output can carry on after the input stops, for getTailLengthSeconds()
+    // and for deciding when the instance can go to sleep
+    double calculateTailSeconds(const ParameterSnapshot& params) const noexcept;
+
+    // The most the chain can amplify a signal near silence by, for the silence detector
+    static float calculateSmallSignalGain(const ParameterSnapshot& params) noexcept;
 
-    // Internal processing functions
-    float bitCrush(float sample, int bits);
-    float downsample(float sample, float factor);
-    // <<< UPDATE THE WAVESHAPER FUNCTION SIGNATURE
-    float waveshaper(float sample, float drive, DistortionType type);
+    // The waveshaper runs a whole channel at a time through the kernels in WaveshaperKernels.h.
+    // Switch this to Reference to compare against the original std::tanh/std::sin code.
+    WaveshaperKernels::Implementation shaperImplementation = WaveshaperKernels::getBestImplementation();
 
 	// Helper methods for preset management
     juce::File getPresetsDirectory();
@@ -89,47 +177,59 @@ private:
 
     // In PluginProcessor.h:
     // Add the new helper methods
-    void processAudio(juce::AudioBuffer<float>& buffer,
-        float drive, float bitDepth, float sampleRateReduction,
-        FilterType filterType, FilterRouting filterRouting,
-        float cutoff, float resonance, DistortionType distortionType);
-
-    void processOversampledBlock(juce::dsp::AudioBlock<float>& oversampledBlock,
-        float drive, float bitDepth, float sampleRateReduction,
-        FilterType filterType, FilterRouting filterRouting,
-        float cutoff, float resonance, DistortionType distortionType);
-
-    void applyMix(juce::AudioBuffer<float>& buffer,
-        const juce::AudioBuffer<float>& dryBuffer,
-        float mix);
-
-    // Limiter components
-    juce::dsp::Limiter<float> limiter;
-    bool limiterEnabled = true;  // Default to enabled
-
-    // Limiter parameters
-    std::atomic<float>* limiterThresholdParam = nullptr;
-    std::atomic<float>* limiterReleaseParam = nullptr;
-    std::atomic<float>* limiterEnabledParam = nullptr;
-
-    // Gain parameters
-    std::atomic<float>* inputGainParam = nullptr;
-    std::atomic<float>* outputGainParam = nullptr;
-
-    // Level meter variables
-    std::array<float, 2> inputLevels = { 0.0f, 0.0f };  // For stereo (left/right)
-    std::array<float, 2> outputLevels = { 0.0f, 0.0f }; // For stereo (left/right)
-    float levelDecayRate = 0.8f;                   // How quickly the meters fall
-
-    // Bypass parameter
-    std::atomic<float>* bypassParam = nullptr;
-    bool isBypassed = false;
-
-    // Stereo width parameter
-    std::atomic<float>* stereoWidthParam = nullptr;
-
-    // Stereo width processing
-    void applyStereoWidth(juce::AudioBuffer<float>& buffer, float width);
+    // Runs the wet path on a block: up through the oversampler (if any), the chain, and back down
+    template <typename SampleType>
+    void processWet(juce::dsp::AudioBlock<SampleType>& block, juce::dsp::Oversampling<SampleType>* oversampler,
+                    const ParameterSnapshot& params, const ParameterRamps::BlockRamps& ramps,
+                    ProcessingChain::State<SampleType>& state);
+
+    // Runs the chain on a block at the given rate (0 = 1x ... 4 = 16x). While drive is
+    // moving, it's run in sub-blocks, each with the drive from the ramps at its middle.
+    template <typename SampleType>
+    void processAudio(juce::dsp::AudioBlock<SampleType>& block, int rateIndex, const ParameterSnapshot& params,
+                      const ParameterRamps::BlockRamps& ramps, ProcessingChain::State<SampleType>& state);
+
+    // Level meter readings, sent to the editor
+    Metering::Transport meterTransport;
+    Metering::Frame meterFrame;     // Audio thread only
+    juce::int64 samplePosition = 0; // Samples processed since prepareToPlay, for the frame timestamps
+
+    // BS.1770 loudness of the output; the audio thread only feeds it, the gating runs on a thread shared by all instances
+    Loudness::Meter loudnessMeter;
+
+    // Pre- and post-distortion spectra; the audio thread only copies samples into it
+    Spectrum::Analyser spectrumAnalyser;
+
+    // The left/right pairs of the current layout, for the stereo width. Set in prepareToPlay.
+    ChannelLayout::Pairs widthPairs;
+
+    // Worker threads for spreading the channels of big blocks over several cores. They're
+    // started the first time multi-core is switched on, from the message thread.
+    WorkerPool workers;
+    std::atomic<int> numWorkersWanted { 0 }; // Set in prepareToPlay
+    std::atomic<bool> prepared { false };    // Between prepareToPlay and releaseResources
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+
+    // Idle skipping while the input is silent (see SilenceDetector.h)
+    SilenceDetector silenceDetector;    // Audio thread only
+    std::atomic<bool> sleeping { false };
+
+    // Glides for the continuous parameters, so automation doesn't step at block boundaries
+    ParameterRamps::Smoothers smoothers;    // Audio thread only
+
+    std::atomic<int> tileSize { ProcessingChain::defaultTileSize };
+
+    // The body of processBlock; forceBypass is set when the host calls processBlockBypassed
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer, bool forceBypass);
+
+    // Everything on the real-time path is sized for the block size given to prepareToPlay,
+    // but hosts don't always keep to it. Bigger blocks are split into chunks of at most that
+    // size and run through process() one after the other; every stage carries its state
+    // over, so the output is as if the block had come in pieces from the host.
+    template <typename SampleType>
+    void processInChunks(juce::AudioBuffer<SampleType>& buffer, bool forceBypass);
+    int maxChunkSize = 0;   // Set in prepareToPlay
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NaniDistortionAudioProcessor)
 };
\ No newline at end of file
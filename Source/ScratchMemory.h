@@ -0,0 +1,94 @@
+// ScratchMemory.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "Multiband.h"
+
+// All of the working memory the real-time path needs, allocated once in prepareToPlay.
+// processBlock only ever copies into or reads from these buffers, so nothing on the
+// audio thread touches the heap.
+template <typename SampleType>
+class ScratchMemory
+{
+public:
+    void prepare(int numChannels, int maxBlockSize)
+    {
+        numPreparedChannels = numChannels;
+        maxPreparedBlockSize = maxBlockSize;
+
+        // Copy of the input for the outgoing path while the oversampler is being switched
+        crossfadeBuffer.setSize(numChannels, maxBlockSize, false, true, false);
+
+        // Copy of the delayed dry signal, for putting it through the crossover's allpasses
+        allpassedDryBuffer.setSize(numChannels, maxBlockSize, false, true, false);
+
+        // One chunk of each band of the multiband mode for every channel, shared by all rates
+        bandBuffer.setSize(numChannels * Multiband::maxBands, Multiband::chunkSize, false, true, false);
+    }
+
+    void release()
+    {
+        crossfadeBuffer.setSize(0, 0);
+        allpassedDryBuffer.setSize(0, 0);
+        bandBuffer.setSize(0, 0);
+        numPreparedChannels = 0;
+        maxPreparedBlockSize = 0;
+    }
+
+    // Copies the block into the crossfade buffer and returns a block covering just those samples
+    juce::dsp::AudioBlock<SampleType> copyForCrossfade(const juce::AudioBuffer<SampleType>& source)
+    {
+        const int numChannels = juce::jmin(source.getNumChannels(), crossfadeBuffer.getNumChannels());
+        const int numSamples = juce::jmin(source.getNumSamples(), crossfadeBuffer.getNumSamples());
+
+        // The host sent a bigger block than it promised in prepareToPlay
+        jassert(numSamples == source.getNumSamples());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            crossfadeBuffer.copyFrom(channel, 0, source, channel, 0, numSamples);
+
+        return juce::dsp::AudioBlock<SampleType>(crossfadeBuffer).getSubsetChannelBlock(0, (size_t)numChannels)
+                                                            .getSubBlock(0, (size_t)numSamples);
+    }
+
+    const juce::AudioBuffer<SampleType>& getCrossfadeBuffer() const { return crossfadeBuffer; }
+
+    // Copies the first numSamples of the dry signal so they can be processed without touching
+    // the original. Only those samples of the returned buffer are valid.
+    juce::AudioBuffer<SampleType>& copyDry(const juce::AudioBuffer<SampleType>& source, int numSamples)
+    {
+        const int numChannels = juce::jmin(source.getNumChannels(), allpassedDryBuffer.getNumChannels());
+        jassert(numSamples <= juce::jmin(source.getNumSamples(), allpassedDryBuffer.getNumSamples()));
+        numSamples = juce::jmin(numSamples, source.getNumSamples(), allpassedDryBuffer.getNumSamples());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            allpassedDryBuffer.copyFrom(channel, 0, source, channel, 0, numSamples);
+
+        return allpassedDryBuffer;
+    }
+
+    juce::AudioBuffer<SampleType>& getBandBuffer() { return bandBuffer; }
+
+    int getNumChannels() const { return numPreparedChannels; }
+    int getMaxBlockSize() const { return maxPreparedBlockSize; }
+
+    size_t getMemoryUsage() const
+    {
+        size_t bytes = 0;
+
+        for (auto* buffer : { &crossfadeBuffer, &allpassedDryBuffer, &bandBuffer })
+            bytes += (size_t)(buffer->getNumChannels() * buffer->getNumSamples()) * sizeof(SampleType);
+
+        return bytes;
+    }
+
+private:
+    juce::AudioBuffer<SampleType> crossfadeBuffer;
+    juce::AudioBuffer<SampleType> allpassedDryBuffer;
+    juce::AudioBuffer<SampleType> bandBuffer;
+
+    int numPreparedChannels = 0;
+    int maxPreparedBlockSize = 0;
+
+    JUCE_LEAK_DETECTOR(ScratchMemory)
+};
@@ -0,0 +1,92 @@
+// SilenceDetector.h
+#pragma once
+
+#include <JuceHeader.h>
+
+// Lets an instance go to sleep while its input is silent.
+//
+// Every block, the input is checked against a threshold far below anything audible, scaled
+// down by the most the chain can amplify a signal that small (the gains, the shaper's slope
+// at zero and the filter's resonance; see calculateSmallSignalGain() in the processor), so
+// an input that passes could only come out below the threshold. The instance goes to sleep
+// once the input has been silent for longer than the tail of the chain (the latency, the
+// filter and crossover ringing, the limiter's release) and the last block that was
+// processed came out below the threshold as well. From then on blocks are replaced with
+// zeros and nothing else runs.
+//
+// The first block with any signal in it wakes the instance up and is processed normally.
+// By then every filter, oversampler and envelope had settled to silence, so starting
+// them again from a reset state gives the same output they would have, with no click.
+class SilenceDetector
+{
+public:
+    // -100 dBFS at the output
+    static constexpr float threshold = 1.0e-5f;
+
+    void reset() noexcept
+    {
+        silentSamples = 0;
+        sleeping = false;
+        waking = false;
+        outputSilent = false;
+    }
+
+    // True if every sample of the first numSamples of every channel, times gain, is below the
+    // threshold. gain is the most the chain can amplify the input by.
+    template <typename SampleType>
+    static bool isSilent(const SampleType* const* channels, int numChannels, int numSamples, float gain) noexcept
+    {
+        const auto limit = (SampleType)(threshold / juce::jmax(gain, 1.0e-6f));
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const auto range = juce::FloatVectorOperations::findMinAndMax(channels[channel], numSamples);
+
+            if (range.getStart() <= -limit || range.getEnd() >= limit)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Audio thread, once per block, before processing. tailSamples is how long the output can
+    // go on after the input stops. Returns true if the block can be skipped.
+    bool update(bool blockIsSilent, int numSamples, int tailSamples) noexcept
+    {
+        waking = false;
+
+        if (!blockIsSilent)
+        {
+            waking = sleeping;
+            sleeping = false;
+            silentSamples = 0;
+            return false;
+        }
+
+        // Everything up to the end of the last audible input has to be out before we stop, and
+        // what came out last has to be below the threshold too
+        if (silentSamples >= tailSamples && outputSilent)
+            sleeping = true;
+        else
+            silentSamples += numSamples;
+
+        return sleeping;
+    }
+
+    // Audio thread, after every block that was processed: its loudest output sample
+    void outputProcessed(float peak) noexcept
+    {
+        outputSilent = peak < threshold;
+    }
+
+    bool isSleeping() const noexcept { return sleeping; }
+
+    // True for the first block after sleeping, when the wet path should start from a clean state
+    bool isWaking() const noexcept { return waking; }
+
+private:
+    int silentSamples = 0;
+    bool sleeping = false;
+    bool waking = false;
+    bool outputSilent = false;
+};
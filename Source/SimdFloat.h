@@ -0,0 +1,269 @@
+// SimdFloat.h
+#pragma once
+
+#include <JuceHeader.h>
+
+// A tiny float vector abstraction used by the block-based DSP kernels.
+//
+// Simd::Float4 wraps four floats in an SSE2 register on x86/x64 or a NEON register
+// on ARM64, and Simd::Float1 offers exactly the same interface on a single float.
+// Kernels are written once as templates over the vector type: the bulk of a block
+// runs on Float4 and the leftover samples at the end go through Float1, which does
+// the same arithmetic so the result doesn't depend on where a sample falls.
+//
+// Simd::Double1 is the double precision counterpart of Float1, for the kernels that also
+// run on the double precision path. It only has the operations those need.
+//
+// We don't use juce::dsp::SIMDRegister here because it has no division and no way
+// to reinterpret float bits as integers, both of which the tanh/sin kernels need.
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define NANI_SIMD_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+ #include <arm_neon.h>
+ #define NANI_SIMD_NEON 1
+#endif
+
+#if NANI_SIMD_SSE2 || NANI_SIMD_NEON
+ #define NANI_SIMD_AVAILABLE 1
+#else
+ #define NANI_SIMD_AVAILABLE 0
+#endif
+
+namespace Simd
+{
+    //==============================================================================
+    // One float, with the same interface as Float4. Comparisons return a value whose
+    // bits are all ones or all zeros, just like the SIMD versions.
+    struct Float1
+    {
+        static constexpr int size = 1;
+
+        float value;
+
+        static Float1 load(const float* source) noexcept { return { *source }; }
+        void store(float* dest) const noexcept { *dest = value; }
+        static Float1 expand(float v) noexcept { return { v }; }
+
+        // start, start + step, start + 2 * step ... across the elements
+        static Float1 ramp(float start, float) noexcept { return { start }; }
+
+        friend Float1 operator+(Float1 a, Float1 b) noexcept { return { a.value + b.value }; }
+        friend Float1 operator-(Float1 a, Float1 b) noexcept { return { a.value - b.value }; }
+        friend Float1 operator*(Float1 a, Float1 b) noexcept { return { a.value * b.value }; }
+        friend Float1 operator/(Float1 a, Float1 b) noexcept { return { a.value / b.value }; }
+
+        friend Float1 operator&(Float1 a, Float1 b) noexcept { return fromBits(toBits(a) & toBits(b)); }
+        friend Float1 operator|(Float1 a, Float1 b) noexcept { return fromBits(toBits(a) | toBits(b)); }
+        friend Float1 operator^(Float1 a, Float1 b) noexcept { return fromBits(toBits(a) ^ toBits(b)); }
+
+        static Float1 min(Float1 a, Float1 b) noexcept { return { a.value < b.value ? a.value : b.value }; }
+        static Float1 max(Float1 a, Float1 b) noexcept { return { a.value > b.value ? a.value : b.value }; }
+        static Float1 abs(Float1 a) noexcept { return fromBits(toBits(a) & 0x7fffffffu); }
+
+        // All bits set where a < b
+        static Float1 lessThan(Float1 a, Float1 b) noexcept { return fromBits(a.value < b.value ? 0xffffffffu : 0u); }
+
+        // Picks a where the mask is set, b elsewhere
+        static Float1 select(Float1 mask, Float1 a, Float1 b) noexcept
+        {
+            return fromBits((toBits(mask) & toBits(a)) | (~toBits(mask) & toBits(b)));
+        }
+
+        // Just the sign bit of each element
+        static Float1 signBit(Float1 a) noexcept { return fromBits(toBits(a) & 0x80000000u); }
+
+        // Rounds to the nearest integer (ties to even)
+        static Float1 roundNearest(Float1 a) noexcept { return { std::nearbyint(a.value) }; }
+
+        // 2^n, for an integral n in the normal exponent range
+        static Float1 pow2(Float1 n) noexcept
+        {
+            return fromBits((uint32_t)((int32_t)std::nearbyint(n.value) + 127) << 23);
+        }
+
+        // The sign bit wherever the integral value n is odd
+        static Float1 oddSignMask(Float1 n) noexcept
+        {
+            return fromBits((uint32_t)(int32_t)std::nearbyint(n.value) << 31);
+        }
+
+        // XORs the raw bits of each element with the same integer mask
+        static Float1 xorBits(Float1 a, int32_t mask) noexcept { return fromBits(toBits(a) ^ (uint32_t)mask); }
+
+    private:
+        static uint32_t toBits(Float1 a) noexcept
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &a.value, sizeof(bits));
+            return bits;
+        }
+
+        static Float1 fromBits(uint32_t bits) noexcept
+        {
+            Float1 result;
+            std::memcpy(&result.value, &bits, sizeof(bits));
+            return result;
+        }
+    };
+
+    //==============================================================================
+    struct Double1
+    {
+        static constexpr int size = 1;
+
+        double value;
+
+        static Double1 load(const double* source) noexcept { return { *source }; }
+        void store(double* dest) const noexcept { *dest = value; }
+        static Double1 expand(double v) noexcept { return { v }; }
+        static Double1 ramp(double start, double) noexcept { return { start }; }
+
+        friend Double1 operator+(Double1 a, Double1 b) noexcept { return { a.value + b.value }; }
+        friend Double1 operator-(Double1 a, Double1 b) noexcept { return { a.value - b.value }; }
+        friend Double1 operator*(Double1 a, Double1 b) noexcept { return { a.value * b.value }; }
+
+        static Double1 min(Double1 a, Double1 b) noexcept { return { a.value < b.value ? a.value : b.value }; }
+        static Double1 max(Double1 a, Double1 b) noexcept { return { a.value > b.value ? a.value : b.value }; }
+        static Double1 abs(Double1 a) noexcept { return { std::abs(a.value) }; }
+
+        // Unlike Float1, the mask is just 1 or 0; select() is the only thing that reads it
+        static Double1 lessThan(Double1 a, Double1 b) noexcept { return { a.value < b.value ? 1.0 : 0.0 }; }
+        static Double1 select(Double1 mask, Double1 a, Double1 b) noexcept { return mask.value != 0.0 ? a : b; }
+    };
+
+#if NANI_SIMD_SSE2
+    //==============================================================================
+    struct Float4
+    {
+        static constexpr int size = 4;
+
+        __m128 value;
+
+        static Float4 load(const float* source) noexcept { return { _mm_loadu_ps(source) }; }
+        void store(float* dest) const noexcept { _mm_storeu_ps(dest, value); }
+        static Float4 expand(float v) noexcept { return { _mm_set1_ps(v) }; }
+
+        static Float4 ramp(float start, float step) noexcept
+        {
+            return { _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(step))) };
+        }
+
+        friend Float4 operator+(Float4 a, Float4 b) noexcept { return { _mm_add_ps(a.value, b.value) }; }
+        friend Float4 operator-(Float4 a, Float4 b) noexcept { return { _mm_sub_ps(a.value, b.value) }; }
+        friend Float4 operator*(Float4 a, Float4 b) noexcept { return { _mm_mul_ps(a.value, b.value) }; }
+        friend Float4 operator/(Float4 a, Float4 b) noexcept { return { _mm_div_ps(a.value, b.value) }; }
+
+        friend Float4 operator&(Float4 a, Float4 b) noexcept { return { _mm_and_ps(a.value, b.value) }; }
+        friend Float4 operator|(Float4 a, Float4 b) noexcept { return { _mm_or_ps(a.value, b.value) }; }
+        friend Float4 operator^(Float4 a, Float4 b) noexcept { return { _mm_xor_ps(a.value, b.value) }; }
+
+        static Float4 min(Float4 a, Float4 b) noexcept { return { _mm_min_ps(a.value, b.value) }; }
+        static Float4 max(Float4 a, Float4 b) noexcept { return { _mm_max_ps(a.value, b.value) }; }
+        static Float4 abs(Float4 a) noexcept { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.value) }; }
+
+        static Float4 lessThan(Float4 a, Float4 b) noexcept { return { _mm_cmplt_ps(a.value, b.value) }; }
+
+        static Float4 select(Float4 mask, Float4 a, Float4 b) noexcept
+        {
+            return { _mm_or_ps(_mm_and_ps(mask.value, a.value), _mm_andnot_ps(mask.value, b.value)) };
+        }
+
+        static Float4 signBit(Float4 a) noexcept { return { _mm_and_ps(a.value, _mm_set1_ps(-0.0f)) }; }
+
+        static Float4 roundNearest(Float4 a) noexcept { return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.value)) }; }
+
+        static Float4 pow2(Float4 n) noexcept
+        {
+            const __m128i exponent = _mm_add_epi32(_mm_cvtps_epi32(n.value), _mm_set1_epi32(127));
+            return { _mm_castsi128_ps(_mm_slli_epi32(exponent, 23)) };
+        }
+
+        static Float4 oddSignMask(Float4 n) noexcept
+        {
+            return { _mm_castsi128_ps(_mm_slli_epi32(_mm_cvtps_epi32(n.value), 31)) };
+        }
+
+        static Float4 xorBits(Float4 a, int32_t mask) noexcept
+        {
+            return { _mm_xor_ps(a.value, _mm_castsi128_ps(_mm_set1_epi32(mask))) };
+        }
+    };
+#elif NANI_SIMD_NEON
+    //==============================================================================
+    struct Float4
+    {
+        static constexpr int size = 4;
+
+        float32x4_t value;
+
+        static Float4 load(const float* source) noexcept { return { vld1q_f32(source) }; }
+        void store(float* dest) const noexcept { vst1q_f32(dest, value); }
+        static Float4 expand(float v) noexcept { return { vdupq_n_f32(v) }; }
+
+        static Float4 ramp(float start, float step) noexcept
+        {
+            static const float lanes[] = { 0.0f, 1.0f, 2.0f, 3.0f };
+            return { vmlaq_f32(vdupq_n_f32(start), vld1q_f32(lanes), vdupq_n_f32(step)) };
+        }
+
+        friend Float4 operator+(Float4 a, Float4 b) noexcept { return { vaddq_f32(a.value, b.value) }; }
+        friend Float4 operator-(Float4 a, Float4 b) noexcept { return { vsubq_f32(a.value, b.value) }; }
+        friend Float4 operator*(Float4 a, Float4 b) noexcept { return { vmulq_f32(a.value, b.value) }; }
+        friend Float4 operator/(Float4 a, Float4 b) noexcept { return { vdivq_f32(a.value, b.value) }; }
+
+        friend Float4 operator&(Float4 a, Float4 b) noexcept { return fromBits(vandq_u32(toBits(a), toBits(b))); }
+        friend Float4 operator|(Float4 a, Float4 b) noexcept { return fromBits(vorrq_u32(toBits(a), toBits(b))); }
+        friend Float4 operator^(Float4 a, Float4 b) noexcept { return fromBits(veorq_u32(toBits(a), toBits(b))); }
+
+        static Float4 min(Float4 a, Float4 b) noexcept { return { vminq_f32(a.value, b.value) }; }
+        static Float4 max(Float4 a, Float4 b) noexcept { return { vmaxq_f32(a.value, b.value) }; }
+        static Float4 abs(Float4 a) noexcept { return { vabsq_f32(a.value) }; }
+
+        static Float4 lessThan(Float4 a, Float4 b) noexcept { return fromBits(vcltq_f32(a.value, b.value)); }
+
+        static Float4 select(Float4 mask, Float4 a, Float4 b) noexcept
+        {
+            return { vbslq_f32(toBits(mask), a.value, b.value) };
+        }
+
+        static Float4 signBit(Float4 a) noexcept { return fromBits(vandq_u32(toBits(a), vdupq_n_u32(0x80000000u))); }
+
+        static Float4 roundNearest(Float4 a) noexcept { return { vrndnq_f32(a.value) }; }
+
+        static Float4 pow2(Float4 n) noexcept
+        {
+            const int32x4_t exponent = vaddq_s32(vcvtnq_s32_f32(n.value), vdupq_n_s32(127));
+            return { vreinterpretq_f32_s32(vshlq_n_s32(exponent, 23)) };
+        }
+
+        static Float4 oddSignMask(Float4 n) noexcept
+        {
+            return { vreinterpretq_f32_s32(vshlq_n_s32(vcvtnq_s32_f32(n.value), 31)) };
+        }
+
+        static Float4 xorBits(Float4 a, int32_t mask) noexcept
+        {
+            return fromBits(veorq_u32(toBits(a), vdupq_n_u32((uint32_t)mask)));
+        }
+
+    private:
+        static uint32x4_t toBits(Float4 a) noexcept { return vreinterpretq_u32_f32(a.value); }
+        static Float4 fromBits(uint32x4_t bits) noexcept { return { vreinterpretq_f32_u32(bits) }; }
+    };
+#endif
+
+    //==============================================================================
+    // Whether the vector path can be used on the machine we're running on.
+    inline bool isAvailable() noexcept
+    {
+       #if NANI_SIMD_SSE2
+        return juce::SystemStats::hasSSE2();
+       #elif NANI_SIMD_NEON
+        return true;
+       #else
+        return false;
+       #endif
+    }
+}
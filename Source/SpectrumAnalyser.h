@@ -0,0 +1,406 @@
+// SpectrumAnalyser.h
+#pragma once
+
+#include <JuceHeader.h>
+
+// Spectrum analysis of the signal going into the distortion and coming out of it, so the
+// editor can show what the shaper adds.
+//
+// The audio thread only copies samples: each Tap has a single-producer, single-consumer
+// FIFO holding the first two channels, and push() is a memcpy per channel (in double
+// precision, a copy converting to float). If the FIFO is full the rest of the block is
+// dropped; pushing never blocks.
+//
+// An analysis thread drains the FIFOs. Every hopSize samples (75% overlap) it windows the
+// last fftSize samples of the two channels' average with a Hann window and runs a
+// juce::dsp::FFT. The magnitudes are gathered onto numPoints log-spaced frequencies from
+// 20 Hz to 20 kHz (the loudest of the bins under each point, or for a point with none, a
+// value interpolated between the bins either side) and smoothed over time in dB. A sine
+// reads its level exactly when it sits on a bin and up to 1.4 dB low halfway between two,
+// which is the Hann window's scalloping; Tests/Source/AnalyserTests.cpp checks both. The
+// editor copies the latest curves out with getLevels().
+//
+// The analyser only runs while an editor is open: start() and stop() come from the editor,
+// and while it's stopped there's no thread and push() returns straight away.
+namespace Spectrum
+{
+    static constexpr int fftOrder = 12;
+    static constexpr int fftSize = 1 << fftOrder;   // 4096: about 12 Hz per bin at 48 kHz
+    static constexpr int hopSize = fftSize / 4;
+    static constexpr int numPoints = 256;
+
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float maxFrequency = 20000.0f;
+    static constexpr float floorDecibels = -100.0f;
+
+    enum Tap { PreDistortion, PostDistortion, numTaps };
+
+    // One curve: the level at each display point, in dB relative to a full scale sine
+    using Levels = std::array<float, numPoints>;
+
+    // The frequency of a display point
+    inline float getPointFrequency(int point) noexcept
+    {
+        return minFrequency * std::pow(maxFrequency / minFrequency, (float)point / (float)(numPoints - 1));
+    }
+
+    //==============================================================================
+    class Analyser
+    {
+    public:
+        Analyser()
+        {
+            for (auto& tap : taps)
+                for (auto& channel : tap.channels)
+                    channel.assign((size_t)capacity, 0.0f);
+
+            for (auto& levels : published)
+                levels.fill(floorDecibels);
+        }
+
+        ~Analyser()
+        {
+            stop();
+        }
+
+        // Message thread: the rate the taps run at
+        void prepare(double newSampleRate) noexcept
+        {
+            sampleRate.store(newSampleRate);
+        }
+
+        // Message thread, when an editor opens
+        void start()
+        {
+            if (analysisThread.isThreadRunning())
+                return;
+
+            // The thread isn't running, so its state can be cleared from here
+            for (auto& state : states)
+                state.clear();
+
+            // And the editor starts from empty curves rather than the ones from last time
+            {
+                const juce::SpinLock::ScopedLockType lock(publishedLock);
+
+                for (auto& levels : published)
+                    levels.fill(floorDecibels);
+
+                publishedVersion.fetch_add(1, std::memory_order_release);
+            }
+
+            active.store(true);
+            analysisThread.startThread(juce::Thread::Priority::low);
+        }
+
+        // Message thread, when the editor closes
+        void stop()
+        {
+            active.store(false);
+            analysisThread.stopThread(1000);
+        }
+
+        // Audio thread
+        template <typename SampleType>
+        void push(Tap tapIndex, const SampleType* const* channels, int numChannels, int numSamples) noexcept
+        {
+            if (numChannels <= 0 || !active.load(std::memory_order_relaxed))
+                return;
+
+            auto& tap = taps[(size_t)tapIndex];
+
+            int start1, size1, start2, size2;
+            tap.fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+            // A mono layout fills both with its one channel
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                const auto* source = channels[juce::jmin(channel, numChannels - 1)];
+                auto* destination = tap.channels[(size_t)channel].data();
+
+                copy(destination + start1, source, size1);
+                copy(destination + start2, source + size1, size2);
+            }
+
+            tap.fifo.finishedWrite(size1 + size2);
+        }
+
+        // Message thread: copies out the latest curves. Returns false if nothing has changed
+        // since the last call.
+        bool getLevels(Levels& preDistortion, Levels& postDistortion) noexcept
+        {
+            const auto version = publishedVersion.load(std::memory_order_acquire);
+
+            if (version == lastVersionRead)
+                return false;
+
+            const juce::SpinLock::ScopedLockType lock(publishedLock);
+            preDistortion = published[PreDistortion];
+            postDistortion = published[PostDistortion];
+            lastVersionRead = version;
+            return true;
+        }
+
+        size_t getMemoryUsage() const noexcept
+        {
+            return (size_t)(numTaps * 2 * capacity) * sizeof(float) + sizeof(Analyser);
+        }
+
+    private:
+        //==============================================================================
+        // Enough for a few editor refreshes at 192 kHz
+        static constexpr int capacity = 8192;
+
+        struct TapFifo
+        {
+            juce::AbstractFifo fifo { capacity };
+            std::array<std::vector<float>, 2> channels;
+        };
+
+        template <typename SampleType>
+        static void copy(float* destination, const SampleType* source, int numSamples) noexcept
+        {
+            if (numSamples <= 0)
+                return;
+
+            if constexpr (std::is_same_v<SampleType, float>)
+                std::memcpy(destination, source, (size_t)numSamples * sizeof(float));
+            else
+                for (int i = 0; i < numSamples; ++i)
+                    destination[i] = (float)source[i];
+        }
+
+        //==============================================================================
+        // Where each display point reads from, for one sample rate
+        struct PointMapping
+        {
+            int firstBin = 0;       // The loudest of firstBin .. lastBin, if there's more than one
+            int lastBin = 0;
+            float fraction = 0.0f;  // Otherwise, between firstBin and the bin above
+        };
+
+        // Analysis thread only
+        struct TapState
+        {
+            std::array<float, fftSize> history {};  // The average of the two channels, as a ring
+            int writePosition = 0;
+            int samplesSinceTransform = 0;
+            Levels smoothed {};
+
+            void clear() noexcept
+            {
+                history.fill(0.0f);
+                writePosition = 0;
+                samplesSinceTransform = 0;
+                smoothed.fill(floorDecibels);
+            }
+        };
+
+        class AnalysisThread : public juce::Thread
+        {
+        public:
+            explicit AnalysisThread(Analyser& ownerToUse)
+                : juce::Thread("Nani spectrum"), owner(ownerToUse)
+            {
+            }
+
+            void run() override
+            {
+                owner.discardStaleSamples();
+
+                while (!threadShouldExit())
+                {
+                    owner.analyse();
+                    wait(intervalMilliseconds);
+                }
+            }
+
+        private:
+            // A bit faster than the editor redraws
+            static constexpr double intervalMilliseconds = 15.0;
+
+            Analyser& owner;
+        };
+
+        // Anything pushed before the last stop() is out of date
+        void discardStaleSamples() noexcept
+        {
+            for (auto& tap : taps)
+                tap.fifo.finishedRead(tap.fifo.getNumReady());
+        }
+
+        void analyse() noexcept
+        {
+            const double rate = sampleRate.load();
+
+            if (rate != mappedSampleRate)
+                updateMapping(rate);
+
+            bool transformed = false;
+
+            for (int tapIndex = 0; tapIndex < numTaps; ++tapIndex)
+            {
+                auto& tap = taps[(size_t)tapIndex];
+                auto& state = states[(size_t)tapIndex];
+
+                // Read a hop at a time, so every hop gets its own transform
+                for (;;)
+                {
+                    int start1, size1, start2, size2;
+                    tap.fifo.prepareToRead(hopSize - state.samplesSinceTransform, start1, size1, start2, size2);
+
+                    if (size1 + size2 == 0)
+                        break;
+
+                    append(state, tap, start1, size1);
+                    append(state, tap, start2, size2);
+                    tap.fifo.finishedRead(size1 + size2);
+
+                    if (state.samplesSinceTransform == hopSize)
+                    {
+                        transform(state);
+                        state.samplesSinceTransform = 0;
+                        transformed = true;
+                    }
+                }
+            }
+
+            if (transformed)
+            {
+                const juce::SpinLock::ScopedLockType lock(publishedLock);
+
+                for (int tapIndex = 0; tapIndex < numTaps; ++tapIndex)
+                    published[(size_t)tapIndex] = states[(size_t)tapIndex].smoothed;
+
+                publishedVersion.fetch_add(1, std::memory_order_release);
+            }
+        }
+
+        static void append(TapState& state, const TapFifo& tap, int start, int numSamples) noexcept
+        {
+            const auto* left = tap.channels[0].data() + start;
+            const auto* right = tap.channels[1].data() + start;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                state.history[(size_t)state.writePosition] = 0.5f * (left[i] + right[i]);
+                state.writePosition = (state.writePosition + 1) & (fftSize - 1);
+            }
+
+            state.samplesSinceTransform += numSamples;
+        }
+
+        void transform(TapState& state) noexcept
+        {
+            // Unroll the ring, oldest first, and window it
+            const auto oldest = (size_t)state.writePosition;
+            std::copy(state.history.begin() + (std::ptrdiff_t)oldest, state.history.end(), fftData.begin());
+            std::copy(state.history.begin(), state.history.begin() + (std::ptrdiff_t)oldest,
+                      fftData.begin() + (std::ptrdiff_t)(fftSize - oldest));
+
+            juce::FloatVectorOperations::multiply(fftData.data(), window.data(), fftSize);
+            fft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+            for (int point = 0; point < numPoints; ++point)
+            {
+                const auto& pointMapping = mapping[(size_t)point];
+                float magnitude;
+
+                if (pointMapping.lastBin > pointMapping.firstBin)
+                {
+                    magnitude = juce::FloatVectorOperations::findMaximum(fftData.data() + pointMapping.firstBin,
+                                                                         pointMapping.lastBin - pointMapping.firstBin + 1);
+                }
+                else
+                {
+                    const float below = fftData[(size_t)pointMapping.firstBin];
+                    const float above = fftData[(size_t)juce::jmin(pointMapping.firstBin + 1, fftSize / 2)];
+                    magnitude = below + (above - below) * pointMapping.fraction;
+                }
+
+                const float level = juce::Decibels::gainToDecibels(magnitude * magnitudeScale, floorDecibels);
+
+                // Rises quickly, falls slowly
+                auto& smoothed = state.smoothed[(size_t)point];
+                smoothed += (level - smoothed) * (level > smoothed ? attack : release);
+            }
+        }
+
+        // Works out the bins behind each point, the window and the smoothing for a sample rate
+        void updateMapping(double rate) noexcept
+        {
+            mappedSampleRate = rate;
+            const double binWidth = rate / fftSize;
+            const int nyquistBin = fftSize / 2;
+
+            // The edges between points are halfway between them on the log scale; point p
+            // covers the bins between edge p - 1 and edge p, leaving out DC. Every bin is under
+            // exactly one point, so a peak on a bin is read as it is even where the points
+            // are packed closer than the bins; only the points in between interpolate.
+            auto edgeBin = [&](int point)
+            {
+                const double frequency = getPointFrequency(point) * std::pow(maxFrequency / minFrequency, 0.5 / (numPoints - 1));
+                return frequency / binWidth;
+            };
+
+            for (int point = 0; point < numPoints; ++point)
+            {
+                auto& pointMapping = mapping[(size_t)point];
+                const int lower = juce::jmax(1, (int)std::ceil(edgeBin(point - 1)));
+                const int upper = (int)std::floor(edgeBin(point));
+
+                if (upper >= lower)
+                {
+                    pointMapping.firstBin = juce::jlimit(0, nyquistBin, lower);
+                    pointMapping.lastBin = juce::jlimit(0, nyquistBin, upper);
+                    pointMapping.fraction = 0.0f;
+                }
+                else
+                {
+                    const double bin = juce::jlimit(0.0, (double)nyquistBin, getPointFrequency(point) / binWidth);
+                    pointMapping.firstBin = (int)bin;
+                    pointMapping.lastBin = pointMapping.firstBin;
+                    pointMapping.fraction = (float)(bin - (double)pointMapping.firstBin);
+                }
+            }
+
+            // A full scale sine reads 0 dB whatever the window does to it
+            juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), (size_t)fftSize,
+                                                                     juce::dsp::WindowingFunction<float>::hann, false);
+            magnitudeScale = 2.0f / std::accumulate(window.begin(), window.end(), 0.0f);
+
+            const double hopSeconds = hopSize / rate;
+            attack = (float)(1.0 - std::exp(-hopSeconds / attackSeconds));
+            release = (float)(1.0 - std::exp(-hopSeconds / releaseSeconds));
+        }
+
+        static constexpr double attackSeconds = 0.03;
+        static constexpr double releaseSeconds = 0.4;
+
+        // Audio thread to analysis thread
+        std::array<TapFifo, numTaps> taps;
+        std::atomic<bool> active { false };
+        std::atomic<double> sampleRate { 44100.0 };
+
+        // Analysis thread
+        std::array<TapState, numTaps> states;
+        juce::dsp::FFT fft { fftOrder };
+        std::array<float, 2 * fftSize> fftData {};
+        std::array<float, fftSize> window {};
+        std::array<PointMapping, numPoints> mapping {};
+        double mappedSampleRate = 0.0;
+        float magnitudeScale = 1.0f;
+        float attack = 1.0f;
+        float release = 1.0f;
+
+        // Analysis thread to editor
+        juce::SpinLock publishedLock;
+        std::array<Levels, numTaps> published {};
+        std::atomic<juce::uint32> publishedVersion { 0 };
+        juce::uint32 lastVersionRead = 0;   // Message thread
+
+        AnalysisThread analysisThread { *this };
+
+        JUCE_DECLARE_NON_COPYABLE(Analyser)
+    };
+}
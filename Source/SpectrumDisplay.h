@@ -0,0 +1,127 @@
+// SpectrumDisplay.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "SpectrumAnalyser.h"
+
+// Draws the pre- and post-distortion spectra worked out by Spectrum::Analyser. The curves are
+// turned into stroked outlines when new levels arrive rather than in paint(), and the paths
+// keep their storage between rebuilds, so once they've grown to size redrawing the display
+// doesn't allocate anything of its own.
+class SpectrumDisplay : public juce::Component
+{
+public:
+    SpectrumDisplay()
+    {
+        preLevels.fill(Spectrum::floorDecibels);
+        postLevels.fill(Spectrum::floorDecibels);
+
+        // A start and a line per point, three floats each
+        curve.preallocateSpace(3 * Spectrum::numPoints);
+    }
+
+    // Called from the editor's timer. Only rebuilds and repaints if the analyser has finished
+    // a new frame since last time
+    void update(Spectrum::Analyser& analyser)
+    {
+        if (analyser.getLevels(preLevels, postLevels))
+        {
+            buildPaths();
+            repaint();
+        }
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        auto bounds = getLocalBounds().toFloat();
+
+        g.setColour(juce::Colours::black.withAlpha(0.3f));
+        g.fillRect(bounds);
+
+        // Grid lines at each decade and every 24 dB
+        g.setColour(juce::Colours::darkgrey);
+
+        for (float frequency : { 100.0f, 1000.0f, 10000.0f })
+            g.drawVerticalLine(juce::roundToInt(frequencyToX(frequency)), bounds.getY(), bounds.getBottom());
+
+        for (float decibels = maxDecibels - 24.0f; decibels > minDecibels; decibels -= 24.0f)
+            g.drawHorizontalLine(juce::roundToInt(decibelsToY(decibels)), bounds.getX(), bounds.getRight());
+
+        // The dry curve underneath, the distorted one on top
+        g.setColour(preColour);
+        g.fillPath(preOutline);
+
+        g.setColour(postColour);
+        g.fillPath(postOutline);
+
+        // Legend in the top right corner
+        g.setFont(12.0f);
+        auto legendArea = getLocalBounds().reduced(6, 3).removeFromTop(14);
+
+        g.setColour(postColour);
+        g.drawText("Post", legendArea.removeFromRight(32), juce::Justification::centredRight, false);
+
+        g.setColour(preColour);
+        g.drawText("Pre", legendArea.removeFromRight(32), juce::Justification::centredRight, false);
+
+        g.setColour(juce::Colours::darkgrey);
+        g.drawRect(bounds, 1.0f);
+    }
+
+    void resized() override
+    {
+        buildPaths();
+    }
+
+private:
+    // The range shown. The analyser's floor sits just below the bottom edge
+    static constexpr float minDecibels = -96.0f;
+    static constexpr float maxDecibels = 0.0f;
+
+    const juce::Colour preColour = juce::Colours::grey;
+    const juce::Colour postColour = juce::Colours::orange;
+
+    float pointToX(int point) const noexcept
+    {
+        return (float)getWidth() * (float)point / (float)(Spectrum::numPoints - 1);
+    }
+
+    float frequencyToX(float frequency) const noexcept
+    {
+        return (float)getWidth() * std::log(frequency / Spectrum::minFrequency)
+                                 / std::log(Spectrum::maxFrequency / Spectrum::minFrequency);
+    }
+
+    float decibelsToY(float decibels) const noexcept
+    {
+        return juce::jmap(juce::jlimit(minDecibels, maxDecibels, decibels), minDecibels, maxDecibels, (float)getHeight(), 0.0f);
+    }
+
+    // Path::clear() keeps the path's storage, and createStrokedPath() clears its destination the
+    // same way, so rebuilding reuses the memory from the last time
+    void buildPath(juce::Path& outline, const Spectrum::Levels& levels, float thickness)
+    {
+        curve.clear();
+        curve.startNewSubPath(pointToX(0), decibelsToY(levels[0]));
+
+        for (int point = 1; point < Spectrum::numPoints; ++point)
+            curve.lineTo(pointToX(point), decibelsToY(levels[(size_t)point]));
+
+        juce::PathStrokeType(thickness).createStrokedPath(outline, curve);
+    }
+
+    void buildPaths()
+    {
+        buildPath(preOutline, preLevels, 1.0f);
+        buildPath(postOutline, postLevels, 1.5f);
+    }
+
+    Spectrum::Levels preLevels;
+    Spectrum::Levels postLevels;
+
+    juce::Path curve;       // Scratch for the centre line the outlines are stroked from
+    juce::Path preOutline;
+    juce::Path postOutline;
+
+    JUCE_DECLARE_NON_COPYABLE(SpectrumDisplay)
+};
@@ -0,0 +1,438 @@
+// TruePeakLimiter.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdFloat.h"
+
+// The true-peak detector from ITU-R BS.1770-4 (Annex 2), used by the limiter and the
+// loudness meter
+namespace TruePeak
+{
+    // The four phases of the 48-tap interpolator
+    static constexpr int numTaps = 12;
+    static constexpr int historyLength = numTaps - 1;
+
+    // How far back the sample detect() reports on is
+    static constexpr int delay = 6;
+
+    static constexpr float coefficients[4][numTaps] = {
+        {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+           0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+        { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+           0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+        { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+           0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+        { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+           0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+    };
+
+    // The peak around the sample six before x[i] for one or four values of i at once: the
+    // sample itself, and the four interpolated points between it and the next one. The
+    // four phases are independent sums, so they keep the multipliers busy.
+    template <typename Vec>
+    inline Vec detect(const float* x) noexcept
+    {
+        Vec phases[4];
+
+        for (int phase = 0; phase < 4; ++phase)
+            phases[phase] = Vec::expand(0.0f);
+
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            const auto input = Vec::load(x - tap);
+
+            for (int phase = 0; phase < 4; ++phase)
+                phases[phase] = phases[phase] + Vec::expand(coefficients[phase][tap]) * input;
+        }
+
+        const auto interpolated = Vec::max(Vec::max(Vec::abs(phases[0]), Vec::abs(phases[1])),
+                                           Vec::max(Vec::abs(phases[2]), Vec::abs(phases[3])));
+        return Vec::max(interpolated, Vec::abs(Vec::load(x - delay)));
+    }
+
+    // block must have historyLength samples of history in front of it
+    inline void detectBlock(const float* block, float* peaks, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if NANI_SIMD_AVAILABLE
+        for (; i + Simd::Float4::size <= numSamples; i += Simd::Float4::size)
+            detect<Simd::Float4>(block + i).store(peaks + i);
+       #endif
+
+        for (; i < numSamples; ++i)
+            detect<Simd::Float1>(block + i).store(peaks + i);
+    }
+
+    // The highest peak in a block, with the same history in front of it
+    inline float findPeak(const float* block, int numSamples) noexcept
+    {
+        float peak = 0.0f;
+        int i = 0;
+
+       #if NANI_SIMD_AVAILABLE
+        if (numSamples >= Simd::Float4::size)
+        {
+            auto peaks = Simd::Float4::expand(0.0f);
+
+            for (; i + Simd::Float4::size <= numSamples; i += Simd::Float4::size)
+                peaks = Simd::Float4::max(peaks, detect<Simd::Float4>(block + i));
+
+            float lanes[Simd::Float4::size];
+            peaks.store(lanes);
+
+            for (auto lane : lanes)
+                peak = juce::jmax(peak, lane);
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            peak = juce::jmax(peak, detect<Simd::Float1>(block + i).value);
+
+        return peak;
+    }
+}
+
+// The output limiter: a lookahead brickwall limiter that keeps the true peak, not just the
+// sample peak, under the threshold.
+//
+// juce::dsp::Limiter reacts to the samples as they come and only sees the sample values,
+// so after heavy distortion the reconstructed waveform went over between samples. Here:
+//  - Detection: the 4x oversampling interpolator from ITU-R BS.1770-4 (Annex 2), 48 taps in
+//    four phases of 12, estimates the signal between every pair of samples. It runs over
+//    four samples at a time with Simd::Float4.
+//  - Hold: the loudest peak of the last lookahead + 11 samples, from a sliding-window
+//    maximum kept in a monotonic deque (every peak goes in and comes out at most once, so
+//    it's O(1) per sample however long the window).
+//  - Release: the gain that peak needs is followed instantly on the way down and with a
+//    one-pole release on the way up.
+//  - Attack: a moving average of the gain over the lookahead turns each drop into a
+//    straight ramp that has finished by the time the peak comes out of the delay line.
+// An interpolated point is made from the 12 samples around it, so the ramp has to have
+// finished by the first of them and the hold has to last until the last one: the gain is
+// then flat across every sample the point is made from, and it can't go over the threshold
+// either. A BS.1770 true-peak meter reads at most the threshold on the output, onsets
+// included. A finer 32x reference reads the same on sines up to 11 kHz, up to 0.4 dB over
+// on 15 kHz bursts, and about 2 dB over on hard-clipped noise, which has energy right up
+// to Nyquist where the 4x interpolator underestimates. Tests/Source/LimiterTests.cpp
+// checks the first two, and its benchmarks print the rest and the costs below.
+//
+// With stereo link on, every channel gets the gain for the loudest one, which keeps the
+// image still; off, each channel is limited on its own.
+//
+// The audio is delayed by getLatencySamples(), whether or not the limiter is switched on,
+// so turning it on and off doesn't shift the output in time. Switched off, only the delay
+// runs. Detection and the gain stay in float for either sample type.
+//
+// Per sample and channel (x64, SSE2, GCC -O3, 512-sample blocks): about 11 ns stereo
+// linked, 16 ns unlinked and 15 ns mono, and the same again in double; 0.2 ns switched off.
+template <typename SampleType>
+class TruePeakLimiter
+{
+public:
+    static constexpr double lookaheadSeconds = 0.002;
+
+    void prepare(double newSampleRate, int newMaxBlockSize, int newNumChannels)
+    {
+        sampleRate = newSampleRate;
+        maxBlockSize = juce::jmax(1, newMaxBlockSize);
+        numChannels = juce::jmax(0, newNumChannels);
+        lookahead = juce::jmax(1, juce::roundToInt(sampleRate * lookaheadSeconds));
+
+        delayStride = getLatencySamples() + maxBlockSize;
+        historyStride = historyLength + maxBlockSize;
+
+        delayLines.assign((size_t)(numChannels * delayStride), SampleType(0));
+        histories.assign((size_t)(numChannels * historyStride), 0.0f);
+        gains.assign((size_t)(numChannels * maxBlockSize), 1.0f);
+
+        envelopes.resize((size_t)numChannels);
+
+        // The hold lasts until the last sample of the last point the peak covers has gone out
+        for (auto& envelope : envelopes)
+            envelope.prepare(lookahead, getLatencySamples() + 1);
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        std::fill(delayLines.begin(), delayLines.end(), SampleType(0));
+        std::fill(histories.begin(), histories.end(), 0.0f);
+
+        for (auto& envelope : envelopes)
+            envelope.reset();
+
+        envelopesStale = false;
+    }
+
+    // Frees the buffers until the next prepare()
+    void release()
+    {
+        numChannels = 0;
+
+        std::vector<SampleType>().swap(delayLines);
+        std::vector<float>().swap(histories);
+        std::vector<float>().swap(gains);
+        std::vector<Envelope>().swap(envelopes);
+    }
+
+    // The lookahead, plus the delay of the interpolator and the five samples in front of the
+    // points it reports on, less the sample the moving average ends on
+    int getLatencySamples() const noexcept { return lookahead + TruePeak::delay + tapsBefore - 1; }
+
+    void setParameters(float thresholdDecibels, float releaseMilliseconds, bool newLinked) noexcept
+    {
+        threshold = juce::Decibels::decibelsToGain(thresholdDecibels);
+        releaseCoefficient = (float)std::exp(-1.0 / juce::jmax(1.0, (double)releaseMilliseconds * 0.001 * sampleRate));
+
+        // The envelopes that take over have been sitting idle
+        if (newLinked != linked)
+            envelopesStale = true;
+
+        linked = newLinked;
+    }
+
+    // Limits the channels in place. With limiting off they're only delayed.
+    void process(SampleType* const* channels, int numChannelsToProcess, int numSamples, bool limiting) noexcept
+    {
+        numChannelsToProcess = juce::jmin(numChannelsToProcess, numChannels);
+
+        // Anything the host sends beyond the prepared size goes through in pieces
+        for (int start = 0; start < numSamples; start += maxBlockSize)
+        {
+            const int length = juce::jmin(maxBlockSize, numSamples - start);
+
+            std::array<SampleType*, 64> pieces {};
+
+            for (int channel = 0; channel < juce::jmin(numChannelsToProcess, (int)pieces.size()); ++channel)
+                pieces[(size_t)channel] = channels[channel] + start;
+
+            processPiece(pieces.data(), juce::jmin(numChannelsToProcess, (int)pieces.size()), length, limiting);
+        }
+    }
+
+    size_t getMemoryUsage() const noexcept
+    {
+        size_t bytes = delayLines.size() * sizeof(SampleType) + (histories.size() + gains.size()) * sizeof(float);
+
+        for (const auto& envelope : envelopes)
+            bytes += envelope.getMemoryUsage();
+
+        return bytes;
+    }
+
+private:
+    //==============================================================================
+    static constexpr int historyLength = TruePeak::historyLength;
+
+    // The samples each interpolated point is made from, before and after the pair it falls
+    // between. The ones after are the interpolator's delay, so the hold covers them.
+    static constexpr int tapsBefore = TruePeak::numTaps / 2 - 1;
+    static constexpr int tapsAfter = TruePeak::numTaps / 2;
+    static_assert(tapsAfter == TruePeak::delay, "The hold length assumes the taps after the point are the delay");
+
+    //==============================================================================
+    // The gain for one channel, or for all of them when they're linked
+    class Envelope
+    {
+    public:
+        void prepare(int newLookahead, int newHoldLength)
+        {
+            lookahead = newLookahead;
+            holdLength = newHoldLength;
+
+            // A power of two, so wrapping around is a mask
+            window.assign((size_t)juce::nextPowerOfTwo(holdLength), Entry{});
+            mask = (int)window.size() - 1;
+            averageWindow.assign((size_t)lookahead, 1.0f);
+        }
+
+        void reset() noexcept
+        {
+            front = 0;
+            count = 0;
+            index = 0;
+            released = 1.0f;
+            std::fill(averageWindow.begin(), averageWindow.end(), 1.0f);
+            averagePosition = 0;
+            sum = (double)lookahead;
+        }
+
+        float next(float peak, float threshold, float releaseCoefficient) noexcept
+        {
+            // Peaks no louder than the new one can never be the maximum again
+            while (count > 0 && window[(size_t)((front + count - 1) & mask)].peak <= peak)
+                --count;
+
+            window[(size_t)((front + count) & mask)] = { index, peak };
+            ++count;
+
+            // The window holds the last holdLength peaks
+            if (window[(size_t)front].index <= index - holdLength)
+            {
+                front = (front + 1) & mask;
+                --count;
+            }
+
+            const float held = window[(size_t)front].peak;
+            ++index;
+
+            // Straight down to the gain the held peak needs, back up at the release rate
+            const float target = held > threshold ? threshold / held : 1.0f;
+            released = target < released ? target : target + (released - target) * releaseCoefficient;
+
+            // Moving average over the lookahead. The sum is worked out from scratch once per lap
+            // of the window, so rounding can't build up.
+            sum += (double)(released - averageWindow[(size_t)averagePosition]);
+            averageWindow[(size_t)averagePosition] = released;
+
+            if (++averagePosition == lookahead)
+            {
+                averagePosition = 0;
+                sum = std::accumulate(averageWindow.begin(), averageWindow.end(), 0.0);
+            }
+
+            return (float)(sum / (double)lookahead);
+        }
+
+        size_t getMemoryUsage() const noexcept
+        {
+            return window.size() * sizeof(Entry) + averageWindow.size() * sizeof(float);
+        }
+
+    private:
+        struct Entry
+        {
+            juce::int64 index = 0;
+            float peak = 0.0f;
+        };
+
+        // The monotonic deque: a ring buffer of peaks, loudest at the front, newest at the back
+        std::vector<Entry> window;
+        int mask = 0;
+        int front = 0;
+        int count = 0;
+        juce::int64 index = 0;
+
+        float released = 1.0f;
+
+        std::vector<float> averageWindow;
+        int averagePosition = 0;
+        double sum = 0.0;
+        int lookahead = 1;
+        int holdLength = 2;
+    };
+
+    //==============================================================================
+    void processPiece(SampleType* const* channels, int numChannelsToProcess, int numSamples, bool limiting) noexcept
+    {
+        if (limiting)
+        {
+            if (envelopesStale)
+            {
+                for (auto& envelope : envelopes)
+                    envelope.reset();
+
+                envelopesStale = false;
+            }
+
+            findGains(channels, numChannelsToProcess, numSamples);
+        }
+        else
+        {
+            // Keep the interpolator's history up to date, so it's ready when limiting starts again
+            for (int channel = 0; channel < numChannelsToProcess; ++channel)
+            {
+                appendToHistory(channel, channels[channel], numSamples);
+                keepHistoryTail(channel, numSamples);
+            }
+
+            envelopesStale = true;
+        }
+
+        const int latency = getLatencySamples();
+
+        for (int channel = 0; channel < numChannelsToProcess; ++channel)
+        {
+            auto* data = channels[channel];
+            auto* delay = delayLines.data() + channel * delayStride;
+            const float* gain = gains.data() + (linked ? 0 : channel) * maxBlockSize;
+
+            // The delay line holds the last latency samples, then this block
+            std::copy(data, data + numSamples, delay + latency);
+
+            if (limiting)
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = delay[i] * (SampleType)gain[i];
+            else
+                std::copy(delay, delay + numSamples, data);
+
+            std::copy(delay + numSamples, delay + numSamples + latency, delay);
+        }
+    }
+
+    // Puts a block, in float, after the last historyLength samples of the previous one.
+    // Returns where it starts.
+    float* appendToHistory(int channel, const SampleType* data, int numSamples) noexcept
+    {
+        auto* block = histories.data() + channel * historyStride + historyLength;
+        std::copy(data, data + numSamples, block);
+        return block;
+    }
+
+    // Moves the last historyLength samples to the front, ready for the next block
+    void keepHistoryTail(int channel, int numSamples) noexcept
+    {
+        auto* history = histories.data() + channel * historyStride;
+        std::copy(history + numSamples, history + numSamples + historyLength, history);
+    }
+
+    void findGains(SampleType* const* channels, int numChannelsToProcess, int numSamples) noexcept
+    {
+        // The peaks go in the gain rows first, and get turned into gains in place
+        for (int channel = 0; channel < numChannelsToProcess; ++channel)
+        {
+            const auto* block = appendToHistory(channel, channels[channel], numSamples);
+            auto* peaks = gains.data() + channel * maxBlockSize;
+
+            TruePeak::detectBlock(block, peaks, numSamples);
+
+            keepHistoryTail(channel, numSamples);
+
+            // Linked, the first row ends up with the loudest channel's peaks
+            if (linked && channel > 0)
+                juce::FloatVectorOperations::max(gains.data(), gains.data(), peaks, numSamples);
+        }
+
+        const int numEnvelopes = linked ? juce::jmin(1, numChannelsToProcess) : numChannelsToProcess;
+
+        for (int row = 0; row < numEnvelopes; ++row)
+        {
+            auto& envelope = envelopes[(size_t)row];
+            auto* values = gains.data() + row * maxBlockSize;
+
+            for (int i = 0; i < numSamples; ++i)
+                values[i] = envelope.next(values[i], threshold, releaseCoefficient);
+        }
+    }
+
+    double sampleRate = 44100.0;
+    int maxBlockSize = 1;
+    int numChannels = 0;
+    int lookahead = 1;
+
+    int delayStride = 0;
+    int historyStride = 0;
+    std::vector<SampleType> delayLines;     // Per channel: the delayed audio
+    std::vector<float> histories;           // Per channel: the input, in float, for the interpolator
+    std::vector<float> gains;               // Per channel (or just the first, linked): peaks, then gains
+    std::vector<Envelope> envelopes;
+    bool envelopesStale = false;
+
+    float threshold = 1.0f;
+    float releaseCoefficient = 0.0f;
+    bool linked = true;
+
+    JUCE_LEAK_DETECTOR(TruePeakLimiter)
+};
@@ -0,0 +1,242 @@
+// WorkerPool.h
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdFloat.h"
+#include "AllocationGuard.h"
+
+// A small pool of pre-spawned threads that lets the audio thread spread independent
+// pieces of work (the channels of the oversampled chain) over several cores.
+//
+// Handing work over never allocates or takes a lock on the audio thread: a job is a
+// function pointer and a context pointer, and each worker has its own start and done
+// counters. Tasks are dealt out round-robin, task i to participant i % numParticipants,
+// and the audio thread takes its own share, so which thread runs a task never depends on
+// timing and neither does the output. run() returns once every task is done.
+//
+// After a job a worker spins for a few tens of microseconds, in case the next one follows
+// straight away (the outgoing path of an oversampler crossfade, say), and then sleeps on
+// an event, which is a futex on Linux. Waking it costs the audio thread one signal(). An
+// idle worker sleeps until it's given a job or told to exit; it never wakes on its own.
+//
+// The threads are only started when something is going to use them (see start()), so an
+// instance with multi-core switched off doesn't keep any.
+class WorkerPool
+{
+public:
+    using TaskFunction = void (*)(void* context, int task);
+
+    // Below this many samples per task, handing the work over costs more than it saves
+    static constexpr int minSamplesPerTask = 2048;
+
+    // One worker per channel past the first is as many as the chain can use
+    static constexpr int maxWorkers = 15;
+
+    ~WorkerPool()
+    {
+        release();
+    }
+
+    // Message thread: starts the workers, unless they're already running. This can happen
+    // while the audio thread is processing; it only sees the workers once they've all started.
+    void start(int numWorkersWanted)
+    {
+        const juce::ScopedLock lock(lifecycleLock);
+
+        if (numWorkers.load(std::memory_order_relaxed) > 0)
+            return;
+
+        const int numToStart = juce::jlimit(0, maxWorkers, numWorkersWanted);
+
+        for (int i = 0; i < numToStart; ++i)
+        {
+            auto& worker = workers[(size_t)i];
+            worker = std::make_unique<Worker>(*this, i + 1);
+
+            if (!worker->startRealtimeThread(juce::Thread::RealtimeOptions{}.withPriority(10)))
+                worker->startThread(juce::Thread::Priority::highest);
+        }
+
+        numWorkers.store(numToStart, std::memory_order_release);
+    }
+
+    // Message thread, while the audio thread is stopped
+    void release()
+    {
+        const juce::ScopedLock lock(lifecycleLock);
+
+        numWorkers.store(0);
+
+        for (auto& worker : workers)
+            if (worker != nullptr)
+                worker->signalThreadShouldExit();
+
+        for (auto& worker : workers)
+            worker.reset();
+    }
+
+    int getNumWorkers() const noexcept { return numWorkers.load(std::memory_order_acquire); }
+
+    // Whether numTasks tasks of about samplesPerTask samples each are worth spreading out
+    bool isWorthSplitting(int numTasks, int samplesPerTask) const noexcept
+    {
+        return getNumWorkers() > 0 && numTasks > 1 && samplesPerTask >= minSamplesPerTask;
+    }
+
+    // Audio thread: calls function(task) for every task from 0 to numTasks - 1, spread over
+    // the workers and the calling thread, and returns once they've all finished
+    template <typename Function>
+    void run(int numTasks, Function& function) noexcept
+    {
+        run(numTasks, [](void* context, int task) { (*static_cast<Function*>(context))(task); }, &function);
+    }
+
+    void run(int numTasks, TaskFunction function, void* context) noexcept
+    {
+        const int numParticipants = juce::jmin(numTasks, getNumWorkers() + 1);
+
+        if (numParticipants <= 1)
+        {
+            for (int task = 0; task < numTasks; ++task)
+                function(context, task);
+
+            return;
+        }
+
+        // Only written while every worker is idle; the start counter publishes it
+        job = { function, context, numTasks, numParticipants };
+        ++generation;
+
+        for (int i = 0; i < numParticipants - 1; ++i)
+            workers[(size_t)i]->start(generation);
+
+        runShare(0);
+
+        // The join: nothing after this may touch the buffers until every share is done
+        for (int i = 0; i < numParticipants - 1; ++i)
+            workers[(size_t)i]->waitUntilDone(generation);
+    }
+
+private:
+    struct Job
+    {
+        TaskFunction function = nullptr;
+        void* context = nullptr;
+        int numTasks = 0;
+        int numParticipants = 1;
+    };
+
+    static void pause() noexcept
+    {
+       #if NANI_SIMD_SSE2
+        _mm_pause();
+       #elif NANI_SIMD_NEON && (defined(__GNUC__) || defined(__clang__))
+        __asm__ __volatile__("yield");
+       #endif
+    }
+
+    void runShare(int participant) const noexcept
+    {
+        for (int task = participant; task < job.numTasks; task += job.numParticipants)
+            job.function(job.context, task);
+    }
+
+    //==============================================================================
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(WorkerPool& ownerToUse, int participantToUse)
+            : juce::Thread("Nani worker " + juce::String(participantToUse)),
+              owner(ownerToUse), participant(participantToUse)
+        {
+        }
+
+        ~Worker() override
+        {
+            signalThreadShouldExit();
+            wake.signal();
+            stopThread(1000);
+        }
+
+        // Audio thread
+        void start(juce::uint32 jobGeneration) noexcept
+        {
+            started.store(jobGeneration);
+
+            // Both sides use sequentially consistent accesses here, so either the worker
+            // sees the new job before it sleeps, or we see that it's asleep
+            if (sleeping.load())
+                wake.signal();
+        }
+
+        void waitUntilDone(juce::uint32 jobGeneration) const noexcept
+        {
+            while (finished.load(std::memory_order_acquire) != jobGeneration)
+                pause();
+        }
+
+        void run() override
+        {
+            juce::ScopedNoDenormals noDenormals;
+            juce::uint32 done = 0;
+
+            while (!threadShouldExit())
+            {
+                if (!waitForJob(done))
+                    continue;
+
+                done = started.load(std::memory_order_acquire);
+
+                {
+                    AllocationGuard::ScopedNoAllocation noAllocation;
+                    owner.runShare(participant);
+                }
+
+                finished.store(done, std::memory_order_release);
+            }
+        }
+
+    private:
+        // About 20-50 microseconds of pause instructions, depending on the CPU
+        static constexpr int spinIterations = 1000;
+
+        bool waitForJob(juce::uint32 done)
+        {
+            for (int i = 0; i < spinIterations; ++i)
+            {
+                if (started.load(std::memory_order_acquire) != done)
+                    return true;
+
+                pause();
+            }
+
+            sleeping.store(true);
+
+            // No timeout: the destructor signals the event after asking the thread to exit
+            if (started.load() == done)
+                wake.wait();
+
+            sleeping.store(false);
+            return started.load(std::memory_order_acquire) != done;
+        }
+
+        WorkerPool& owner;
+        const int participant;
+
+        std::atomic<juce::uint32> started { 0 };
+        std::atomic<juce::uint32> finished { 0 };
+        std::atomic<bool> sleeping { false };
+        juce::WaitableEvent wake;
+
+        JUCE_DECLARE_NON_COPYABLE(Worker)
+    };
+
+    std::array<std::unique_ptr<Worker>, maxWorkers> workers;
+    std::atomic<int> numWorkers { 0 }; // Only the first numWorkers are visible to the audio thread
+    juce::CriticalSection lifecycleLock; // Between start() and release(), never the audio thread
+
+    Job job;
+    juce::uint32 generation = 0; // Audio thread only
+
+    JUCE_DECLARE_NON_COPYABLE(WorkerPool)
+};
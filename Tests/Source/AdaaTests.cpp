@@ -0,0 +1,262 @@
+// AdaaTests.cpp
+#include "TestHelpers.h"
+
+// The aliasing table and the costs in AdaaShapers.h come from the benchmarks at the bottom.
+namespace
+{
+    // A full-scale 4.7 kHz sine at 44.1 kHz. The bin is prime, so no harmonic lands on the
+    // bin of another below Nyquist.
+    constexpr double baseSampleRate = 44100.0;
+    constexpr int baseLength = 16384;
+    constexpr int fundamentalBin = 1747;
+
+    // Aliasing of one shaper at an oversampling factor, plain (Adaa::Off) or with ADAA
+    template <DistortionType type>
+    double measureShaper(int oversamplingFactor, Adaa::Order order, float drive = 1.0f)
+    {
+        const int length = baseLength * oversamplingFactor;
+        auto signal = TestHelpers::makeSine<float>(length, fundamentalBin);
+
+        if (order == Adaa::Off)
+        {
+            WaveshaperKernels::processBlock<type>(signal.data(), length, drive, WaveshaperKernels::Implementation::Reference,
+                                                  WaveshaperKernels::MathPrecision::Accurate);
+        }
+        else
+        {
+            // A lap of the signal first, so the history the shaper starts from belongs to it
+            Adaa::Waveshaper shaper;
+            shaper.prepare(1);
+
+            auto lap = signal;
+            shaper.process<type>(lap.data(), length, 0, drive, order);
+            shaper.process<type>(signal.data(), length, 0, drive, order);
+        }
+
+        return TestHelpers::measureAliasing(signal, fundamentalBin, oversamplingFactor);
+    }
+
+    const char* getTypeName(DistortionType type)
+    {
+        switch (type)
+        {
+            case SoftClip:  return "SoftClip";
+            case HardClip:  return "HardClip";
+            case Foldback:  return "Foldback";
+            default:        return "BitGlitch";
+        }
+    }
+}
+
+//==============================================================================
+class AdaaTests : public juce::UnitTest
+{
+public:
+    AdaaTests() : juce::UnitTest("ADAA", "Nani") {}
+
+    void runTest() override
+    {
+        beginTest("Slow signals come out as the curve, delayed");
+        expectFollowsCurve<SoftClip>();
+        expectFollowsCurve<HardClip>();
+        expectFollowsCurve<Foldback>();
+
+        beginTest("ADAA2 cuts the aliasing at 2x");
+        expectCutsAliasing<SoftClip>();
+        expectCutsAliasing<HardClip>();
+        expectCutsAliasing<Foldback>();
+
+        // The corners of the hard clip alias at every rate, so it's the curve ADAA is for
+        beginTest("HardClip at 2x with ADAA2 aliases less than at 8x without");
+        expectLessThan(measureShaper<HardClip>(2, Adaa::SecondOrder), measureShaper<HardClip>(8, Adaa::Off));
+    }
+
+private:
+    // A 20 Hz sine barely moves between samples, so the averages ADAA takes are the curve at
+    // the middle of each step: half a sample late for ADAA1, a sample for ADAA2. The hard
+    // clip's corners are rounded off a little more than the rest.
+    template <DistortionType type>
+    void expectFollowsCurve()
+    {
+        using Curve = typename Adaa::CurveFor<type>::Type;
+        constexpr int length = 4096;
+        constexpr float drive = 0.3f;
+        const double gain = WaveshaperKernels::getGain(drive);
+
+        std::vector<double> input(length);
+
+        for (int i = 0; i < length; ++i)
+            input[(size_t)i] = 0.8 * std::sin(2.0 * juce::MathConstants<double>::pi * 20.0 * i / baseSampleRate);
+
+        for (auto order : { Adaa::FirstOrder, Adaa::SecondOrder })
+        {
+            Adaa::Waveshaper shaper;
+            shaper.prepare(1);
+
+            auto output = input;
+            shaper.process<type>(output.data(), length, 0, drive, order);
+
+            double worst = 0.0;
+
+            for (int i = 2; i < length; ++i)
+            {
+                const double x = order == Adaa::FirstOrder ? 0.5 * (input[(size_t)i] + input[(size_t)i - 1]) : input[(size_t)i - 1];
+                worst = juce::jmax(worst, std::abs(output[(size_t)i] - Curve::function(gain * x)));
+            }
+
+            expectLessThan(worst, 2.0e-3, juce::String(getTypeName(type)) + " ADAA" + juce::String((int)order));
+        }
+    }
+
+    template <DistortionType type>
+    void expectCutsAliasing()
+    {
+        expectLessThan(measureShaper<type>(2, Adaa::SecondOrder), measureShaper<type>(2, Adaa::Off) - 25.0, getTypeName(type));
+    }
+};
+
+static AdaaTests adaaTests;
+
+//==============================================================================
+class AdaaBenchmarks : public juce::UnitTest
+{
+public:
+    AdaaBenchmarks() : juce::UnitTest("ADAA", "Benchmarks") {}
+
+    void runTest() override
+    {
+        beginTest("Aliasing, relative to the fundamental");
+        logMessage("                1x      1x ADAA1  1x ADAA2  2x      2x ADAA1  2x ADAA2  4x      8x      16x");
+        logAliasing<SoftClip>();
+        logAliasing<HardClip>();
+        logAliasing<Foldback>();
+
+        beginTest("Shaper cost per sample");
+        logShaperCost<SoftClip>();
+        logShaperCost<HardClip>();
+        logShaperCost<Foldback>();
+
+        beginTest("Whole chain per host sample and channel");
+        logMessage("Stereo, blocks of " + juce::String(hostBlockSize) + ", default filter. The chain at the processing rate,");
+        logMessage("then the linear phase oversampling filters on top of it.");
+        logChainCost<SoftClip>();
+        logChainCost<HardClip>();
+        logChainCost<Foldback>();
+    }
+
+private:
+    static constexpr int hostBlockSize = 512;
+    static constexpr int numChannels = 2;
+
+    template <DistortionType type>
+    void logAliasing()
+    {
+        juce::String row = juce::String(getTypeName(type)).paddedRight(' ', 16);
+
+        struct Column { int oversamplingFactor; Adaa::Order order; };
+
+        for (const auto& column : { Column { 1, Adaa::Off }, Column { 1, Adaa::FirstOrder }, Column { 1, Adaa::SecondOrder },
+                                    Column { 2, Adaa::Off }, Column { 2, Adaa::FirstOrder }, Column { 2, Adaa::SecondOrder },
+                                    Column { 4, Adaa::Off }, Column { 8, Adaa::Off }, Column { 16, Adaa::Off } })
+        {
+            const double aliasing = measureShaper<type>(column.oversamplingFactor, column.order);
+            row << (juce::String(juce::roundToInt(aliasing)) + " dB").paddedRight(' ', 10);
+        }
+
+        logMessage(row);
+    }
+
+    template <DistortionType type>
+    void logShaperCost()
+    {
+        constexpr int length = 512;
+        std::vector<float> buffer(length);
+        Adaa::Waveshaper shaper;
+        shaper.prepare(1);
+
+        auto refill = [&]
+        {
+            for (int i = 0; i < length; ++i)
+                buffer[(size_t)i] = std::sin((float)i * 0.3f);
+        };
+
+        auto timeShaper = [&](auto&& shape)
+        {
+            return TestHelpers::nanosecondsPer(length * 200.0, [&]
+            {
+                refill();
+
+                for (int repeat = 0; repeat < 200; ++repeat)
+                    shape();
+            });
+        };
+
+        const double plain = timeShaper([&] { WaveshaperKernels::processBlock<type>(buffer.data(), length, 1.0f, WaveshaperKernels::Implementation::Vectorised,
+                                                                                   WaveshaperKernels::MathPrecision::Accurate); });
+        const double firstOrder = timeShaper([&] { shaper.process<type>(buffer.data(), length, 0, 1.0f, Adaa::FirstOrder); });
+        const double secondOrder = timeShaper([&] { shaper.process<type>(buffer.data(), length, 0, 1.0f, Adaa::SecondOrder); });
+
+        logMessage(juce::String(getTypeName(type)).paddedRight(' ', 10) + "plain " + TestHelpers::formatNanoseconds(plain)
+                   + ", ADAA1 " + TestHelpers::formatNanoseconds(firstOrder) + ", ADAA2 " + TestHelpers::formatNanoseconds(secondOrder));
+    }
+
+    template <DistortionType type>
+    void logChainCost()
+    {
+        ParameterSnapshot params;
+        params.distortionType = type;
+
+        TestHelpers::ChainRig<float> rig(baseSampleRate, hostBlockSize, numChannels);
+        juce::String row = juce::String(getTypeName(type)).paddedRight(' ', 10);
+
+        struct Mode { const char* name; int rateIndex; Adaa::Order order; };
+
+        for (const auto& mode : { Mode { "1x ADAA1", 0, Adaa::FirstOrder }, Mode { "1x ADAA2", 0, Adaa::SecondOrder },
+                                  Mode { "2x", 1, Adaa::Off }, Mode { "2x ADAA1", 1, Adaa::FirstOrder },
+                                  Mode { "2x ADAA2", 1, Adaa::SecondOrder }, Mode { "4x", 2, Adaa::Off },
+                                  Mode { "8x", 3, Adaa::Off }, Mode { "16x", 4, Adaa::Off } })
+        {
+            params.antiAliasing = mode.order;
+
+            juce::AudioBuffer<float> buffer(numChannels, hostBlockSize << mode.rateIndex);
+            auto refill = [&]
+            {
+                for (int channel = 0; channel < numChannels; ++channel)
+                    for (int i = 0; i < buffer.getNumSamples(); ++i)
+                        buffer.getWritePointer(channel)[i] = 0.7f * std::sin((float)i * 0.02f / (float)(1 << mode.rateIndex));
+            };
+
+            const double chain = TestHelpers::nanosecondsPer(hostBlockSize * numChannels, [&] { refill(); rig.process(buffer, mode.rateIndex, params); });
+            const double filters = mode.rateIndex > 0 ? measureOversampling(mode.rateIndex) : 0.0;
+
+            row << mode.name << " " << TestHelpers::formatNanoseconds(chain);
+
+            if (filters > 0.0)
+                row << " + " << TestHelpers::formatNanoseconds(filters);
+
+            row << ", ";
+        }
+
+        logMessage(row.dropLastCharacters(2));
+    }
+
+    // Up and back down again, per host sample and channel
+    static double measureOversampling(int numStages)
+    {
+        juce::dsp::Oversampling<float> oversampling((size_t)numChannels, (size_t)numStages,
+                                                    juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple, true);
+        oversampling.initProcessing((size_t)hostBlockSize);
+
+        juce::AudioBuffer<float> buffer(numChannels, hostBlockSize);
+        buffer.clear();
+        juce::dsp::AudioBlock<float> block(buffer);
+
+        return TestHelpers::nanosecondsPer(hostBlockSize * numChannels, [&]
+        {
+            oversampling.processSamplesUp(block);
+            oversampling.processSamplesDown(block);
+        });
+    }
+};
+
+static AdaaBenchmarks adaaBenchmarks;
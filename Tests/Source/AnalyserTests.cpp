@@ -0,0 +1,276 @@
+// AnalyserTests.cpp
+#include "TestHelpers.h"
+#include "../../Source/SpectrumAnalyser.h"
+
+// The level figures in SpectrumAnalyser.h come from here. The analyser is driven through
+// its public interface, on its own thread: each hop is pushed and then waited for, so
+// nothing is dropped and every hop gets its transform.
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr double binWidth = sampleRate / Spectrum::fftSize;
+
+    // Long enough for the window to fill and the smoothing to settle to well under 0.01 dB
+    constexpr int numHops = 32;
+
+    // A sine at a bin, which may be fractional, that sits on a whole number of periods
+    // every fftSize samples when the bin is whole
+    std::vector<float> makeSine(double bin, double amplitude)
+    {
+        std::vector<float> signal((size_t)(numHops * Spectrum::hopSize));
+
+        for (size_t i = 0; i < signal.size(); ++i)
+            signal[i] = (float)(amplitude * std::sin(2.0 * juce::MathConstants<double>::pi * bin * (double)i / Spectrum::fftSize));
+
+        return signal;
+    }
+
+    class AnalyserRig
+    {
+    public:
+        AnalyserRig()
+        {
+            analyser.prepare(sampleRate);
+            analyser.start();
+
+            // The empty curves start() puts up
+            analyser.getLevels(preLevels, postLevels);
+
+            // The thread throws away anything pushed before it got going, so keep feeding it
+            // silence until a frame of it comes out
+            const std::vector<float> silence((size_t)Spectrum::hopSize, 0.0f);
+
+            while (!pushHop(silence.data(), silence.data()))
+            {
+            }
+        }
+
+        ~AnalyserRig()
+        {
+            analyser.stop();
+        }
+
+        // Returns false if a hop wasn't analysed within a second
+        bool run(const std::vector<float>& preDistortion, const std::vector<float>& postDistortion)
+        {
+            jassert(preDistortion.size() == postDistortion.size());
+
+            for (size_t start = 0; start + Spectrum::hopSize <= preDistortion.size(); start += Spectrum::hopSize)
+                if (!pushHop(preDistortion.data() + start, postDistortion.data() + start, 1000))
+                    return false;
+
+            // The other tap's frame may have come out separately
+            juce::Thread::sleep(50);
+            analyser.getLevels(preLevels, postLevels);
+            return true;
+        }
+
+        // The highest point of the curve around a frequency: the nearest point and the ones
+        // either side of it
+        static float readLevel(const Spectrum::Levels& levels, double frequency)
+        {
+            int nearest = 0;
+
+            for (int point = 1; point < Spectrum::numPoints; ++point)
+                if (std::abs(std::log(Spectrum::getPointFrequency(point) / frequency))
+                      < std::abs(std::log(Spectrum::getPointFrequency(nearest) / frequency)))
+                    nearest = point;
+
+            float level = Spectrum::floorDecibels;
+
+            for (int point = juce::jmax(0, nearest - 1); point <= juce::jmin(Spectrum::numPoints - 1, nearest + 1); ++point)
+                level = juce::jmax(level, levels[(size_t)point]);
+
+            return level;
+        }
+
+        Spectrum::Analyser analyser;
+        Spectrum::Levels preLevels {};
+        Spectrum::Levels postLevels {};
+
+    private:
+        bool pushHop(const float* preDistortion, const float* postDistortion, int timeoutMilliseconds = 100)
+        {
+            analyser.push(Spectrum::PreDistortion, &preDistortion, 1, Spectrum::hopSize);
+            analyser.push(Spectrum::PostDistortion, &postDistortion, 1, Spectrum::hopSize);
+
+            for (int waited = 0; waited < timeoutMilliseconds; ++waited)
+            {
+                if (analyser.getLevels(preLevels, postLevels))
+                    return true;
+
+                juce::Thread::sleep(1);
+            }
+
+            return false;
+        }
+    };
+
+    // What a -6 dB sine reads at a bin, on each tap
+    std::pair<float, float> measureSine(double bin)
+    {
+        AnalyserRig rig;
+        const auto signal = makeSine(bin, 0.5);
+        const bool analysed = rig.run(signal, signal);
+        jassert(analysed);
+        juce::ignoreUnused(analysed);
+
+        const double frequency = bin * binWidth;
+        return { AnalyserRig::readLevel(rig.preLevels, frequency), AnalyserRig::readLevel(rig.postLevels, frequency) };
+    }
+}
+
+//==============================================================================
+class AnalyserTests : public juce::UnitTest
+{
+public:
+    AnalyserTests() : juce::UnitTest("Spectrum analyser", "Nani") {}
+
+    void runTest() override
+    {
+        const double sineLevel = juce::Decibels::gainToDecibels(0.5);
+
+        // 105 Hz and 445 Hz, where the points are packed closer than the bins, and 996 Hz and
+        // 9.996 kHz, where each point spans a few bins and reads the loudest
+        beginTest("A sine on a bin reads its level");
+        for (double bin : { 9.0, 38.0, 85.0, 853.0 })
+        {
+            const auto levels = measureSine(bin);
+            expectWithinAbsoluteError((double)levels.first, sineLevel, 0.05);
+            expectWithinAbsoluteError((double)levels.second, sineLevel, 0.05);
+        }
+
+        // The Hann window's scalloping: both bins either side are 1.42 dB down
+        beginTest("A sine halfway between bins reads up to 1.4 dB low");
+        for (double bin : { 9.5, 52.5, 85.5, 853.5 })
+        {
+            const auto level = (double)measureSine(bin).first;
+            expectLessThan(level, sineLevel - 1.3);
+            expectGreaterThan(level, sineLevel - 1.5);
+        }
+
+        // What the display is for: what the shaper added, at the level it was added at
+        beginTest("Harmonics read their level");
+        expectHarmonicsRead();
+
+        beginTest("The curves are empty again after a restart");
+        expectEmptyAfterRestart();
+    }
+
+private:
+    void expectHarmonicsRead()
+    {
+        constexpr double bin = 85.0;
+        const auto dry = makeSine(bin, 0.5);
+        std::vector<float> shaped(dry.size());
+
+        for (size_t i = 0; i < dry.size(); ++i)
+            shaped[i] = std::tanh(4.0f * dry[i]);
+
+        AnalyserRig rig;
+        expect(rig.run(dry, shaped));
+
+        // The exact level of each odd harmonic, from a DFT over one frame
+        for (int harmonic : { 1, 3, 5 })
+        {
+            double sum = 0.0;
+
+            for (int i = 0; i < Spectrum::fftSize; ++i)
+                sum += shaped[(size_t)i] * std::sin(2.0 * juce::MathConstants<double>::pi * bin * harmonic * i / Spectrum::fftSize);
+
+            const double exact = juce::Decibels::gainToDecibels(2.0 * std::abs(sum) / Spectrum::fftSize);
+            expectWithinAbsoluteError((double)AnalyserRig::readLevel(rig.postLevels, bin * harmonic * binWidth), exact, 0.05,
+                                      "harmonic " + juce::String(harmonic));
+        }
+
+        // And the dry signal has none of them
+        expectLessThan((double)AnalyserRig::readLevel(rig.preLevels, 3.0 * bin * binWidth), -90.0);
+    }
+
+    void expectEmptyAfterRestart()
+    {
+        AnalyserRig rig;
+        const auto signal = makeSine(85.0, 0.5);
+        expect(rig.run(signal, signal));
+
+        rig.analyser.stop();
+        rig.analyser.start();
+
+        Spectrum::Levels pre, post;
+        expect(rig.analyser.getLevels(pre, post));
+
+        for (auto level : pre)
+            expectEquals(level, Spectrum::floorDecibels);
+    }
+};
+
+static AnalyserTests analyserTests;
+
+//==============================================================================
+class AnalyserBenchmarks : public juce::UnitTest
+{
+public:
+    AnalyserBenchmarks() : juce::UnitTest("Spectrum analyser", "Benchmarks") {}
+
+    void runTest() override
+    {
+        constexpr int blockSize = 512;
+        std::vector<float> left(blockSize), right(blockSize);
+
+        for (int i = 0; i < blockSize; ++i)
+        {
+            left[(size_t)i] = std::sin((float)i * 0.1f);
+            right[(size_t)i] = std::sin((float)i * 0.2f);
+        }
+
+        const float* channels[] = { left.data(), right.data() };
+
+        // Pushing runs on the audio thread, so it's the cost that matters
+        beginTest("Push, per sample and channel");
+        {
+            Spectrum::Analyser analyser;
+            analyser.prepare(sampleRate);
+            analyser.start();
+
+            // One block at a time, with time in between for the thread to empty the FIFO, so
+            // none of it is dropped
+            double best = std::numeric_limits<double>::max();
+
+            for (int round = 0; round < 50; ++round)
+            {
+                const auto start = juce::Time::getHighResolutionTicks();
+                analyser.push(Spectrum::PostDistortion, channels, 2, blockSize);
+                const auto ticks = juce::Time::getHighResolutionTicks() - start;
+
+                best = juce::jmin(best, juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9 / (2 * blockSize));
+                juce::Thread::sleep(20);
+            }
+
+            analyser.stop();
+            logMessage("Running, stereo float: " + TestHelpers::formatNanoseconds(best));
+        }
+
+        beginTest("Push while stopped, per block");
+        {
+            Spectrum::Analyser analyser;
+            analyser.prepare(sampleRate);
+
+            const double nanoseconds = TestHelpers::nanosecondsPer(1000.0, [&]
+            {
+                for (int repeat = 0; repeat < 1000; ++repeat)
+                    analyser.push(Spectrum::PostDistortion, channels, 2, blockSize);
+            });
+
+            logMessage("Stopped: " + TestHelpers::formatNanoseconds(nanoseconds));
+        }
+
+        beginTest("Levels");
+        logMessage("-6.02 dB sines on a bin, and halfway to the next:");
+
+        for (int bin = 2; bin <= 64; bin += 2)
+            logMessage("  " + juce::String(juce::roundToInt(bin * binWidth)) + " Hz  " + juce::String(measureSine(bin).first, 2)
+                       + " dB, " + juce::String(measureSine(bin + 0.5).first, 2) + " dB");
+    }
+};
+
+static AnalyserBenchmarks analyserBenchmarks;
@@ -0,0 +1,186 @@
+// ChunkingTests.cpp
+#include "TestHelpers.h"
+#include "../../Source/PluginProcessor.h"
+
+// The processor splits blocks bigger than the size it was prepared for into chunks
+// (processInChunks()), and every stage carries its state from one block to the next. So
+// however the host slices the audio up, the output has to be what one big block gives.
+namespace
+{
+    constexpr double sampleRate = 44100.0;
+    constexpr int numChannels = 2;
+
+    // A processor with its parameters set (by their plain values) before it's prepared, so
+    // the oversampler it starts with is the one the settings call for
+    struct TestProcessor
+    {
+        TestProcessor(const std::vector<std::pair<const char*, float>>& settings, int preparedBlockSize)
+        {
+            for (const auto& [parameterID, value] : settings)
+            {
+                auto* parameter = processor.getValueTreeState().getParameter(parameterID);
+                jassert(parameter != nullptr);
+                parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+            }
+
+            processor.setRateAndBufferSizeDetails(sampleRate, preparedBlockSize);
+            processor.prepareToPlay(sampleRate, preparedBlockSize);
+        }
+
+        ~TestProcessor()
+        {
+            processor.releaseResources();
+        }
+
+        // Runs the whole signal through, in blocks of the sizes nextBlockSize() hands out
+        template <typename BlockSizes>
+        juce::AudioBuffer<float> process(const juce::AudioBuffer<float>& input, BlockSizes&& nextBlockSize)
+        {
+            juce::AudioBuffer<float> output(input);
+            juce::MidiBuffer midi;
+
+            for (int start = 0; start < output.getNumSamples();)
+            {
+                const int length = juce::jmin(nextBlockSize(), output.getNumSamples() - start);
+                juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), output.getNumChannels(), start, length);
+                processor.processBlock(block, midi);
+                start += length;
+            }
+
+            return output;
+        }
+
+        NaniDistortionAudioProcessor processor;
+    };
+
+    // Two tones and some noise, loud enough to drive everything into the limiter now and then
+    juce::AudioBuffer<float> makeInput(int length)
+    {
+        juce::AudioBuffer<float> input(numChannels, length);
+        juce::Random random(1234);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int i = 0; i < length; ++i)
+                input.getWritePointer(channel)[i] = 0.6f * std::sin((float)i * (0.013f + 0.002f * (float)channel))
+                                                  + 0.3f * std::sin((float)i * 0.31f)
+                                                  + 0.1f * (random.nextFloat() * 2.0f - 1.0f);
+
+        return input;
+    }
+
+    float getLargestDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        float largest = 0.0f;
+
+        for (int channel = 0; channel < a.getNumChannels(); ++channel)
+            for (int i = 0; i < a.getNumSamples(); ++i)
+                largest = juce::jmax(largest, std::abs(a.getReadPointer(channel)[i] - b.getReadPointer(channel)[i]));
+
+        return largest;
+    }
+
+    struct Settings
+    {
+        const char* name;
+        std::vector<std::pair<const char*, float>> values;
+    };
+
+    const std::vector<Settings>& getSettings()
+    {
+        static const std::vector<Settings> settings {
+            { "Defaults", {} },
+            { "4x, crushed and decimated, ADAA", { { "drive", 1.6f }, { "distortionType", 1.0f }, { "antiAliasing", 2.0f },
+                                                   { "bitdepth", 10.0f }, { "samplerate", 0.23f }, { "decimatorBandLimited", 1.0f },
+                                                   { "decimatorFractional", 1.0f }, { "oversamplingFactor", 2.0f },
+                                                   { "filterCutoff", 3000.0f }, { "filterRouting", 0.0f } } },
+            { "16x low latency, three bands", { { "oversamplingFactor", 4.0f }, { "oversamplingMode", 1.0f },
+                                                { "numBands", 2.0f }, { "band2Type", 2.0f }, { "band3Mix", 0.5f },
+                                                { "mix", 0.7f }, { "stereoWidth", 1.5f } } }
+        };
+
+        return settings;
+    }
+}
+
+//==============================================================================
+class ChunkingTests : public juce::UnitTest
+{
+public:
+    ChunkingTests() : juce::UnitTest("Block sizes", "Nani") {}
+
+    void runTest() override
+    {
+        constexpr int length = 3 * 16384;
+        constexpr int preparedBlockSize = 512;
+        const auto input = makeInput(length);
+
+        for (const auto& settings : getSettings())
+        {
+            beginTest(settings.name);
+
+            // The reference goes through in a single block, prepared for the whole length, so
+            // it's never chunked at all
+            TestProcessor reference(settings.values, length);
+            const auto expected = reference.process(input, [] { return length; });
+
+            auto expectSameOutput = [&](const juce::String& description, auto&& nextBlockSize)
+            {
+                TestProcessor processor(settings.values, preparedBlockSize);
+                const auto output = processor.process(input, nextBlockSize);
+
+                // The stages that run four samples at a time do the leftovers one at a time
+                // with the same maths, so the output should match exactly. Allow for rounding.
+                expectLessOrEqual(getLargestDifference(output, expected), 1.0e-5f, description);
+            };
+
+            for (int blockSize : { 1, 2, 3, 7, 64, 100, 511, 512, 513, 1024, 4096, 16384 })
+                expectSameOutput("Blocks of " + juce::String(blockSize), [blockSize] { return blockSize; });
+
+            auto random = getRandom();
+            expectSameOutput("Random blocks of 1 to 16384", [&random] { return 1 + random.nextInt(16384); });
+            expectSameOutput("Random blocks of 1 to 64", [&random] { return 1 + random.nextInt(64); });
+        }
+    }
+};
+
+static ChunkingTests chunkingTests;
+
+//==============================================================================
+// How throughput varies with the size of the chunks: the host sends blocks of 16384, and
+// the processor is prepared for (so chunks them into) each of the sizes in turn
+class ChunkingBenchmarks : public juce::UnitTest
+{
+public:
+    ChunkingBenchmarks() : juce::UnitTest("Block sizes", "Benchmarks") {}
+
+    void runTest() override
+    {
+        constexpr int hostBlockSize = 16384;
+        const auto input = makeInput(hostBlockSize);
+
+        for (int oversamplingIndex : { 0, 2, 4 })
+        {
+            beginTest("Nanoseconds per sample and channel at " + juce::String(1 << oversamplingIndex) + "x, by chunk size");
+            juce::String row;
+
+            for (int chunkSize : { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 16384 })
+            {
+                TestProcessor processor({ { "oversamplingFactor", (float)oversamplingIndex } }, chunkSize);
+                auto buffer = input;
+                juce::MidiBuffer midi;
+
+                const double nanoseconds = TestHelpers::nanosecondsPer(hostBlockSize * numChannels, [&]
+                {
+                    buffer.makeCopyOf(input, true);
+                    processor.processor.processBlock(buffer, midi);
+                }, 10);
+
+                row << chunkSize << ": " << TestHelpers::formatNanoseconds(nanoseconds) << "  ";
+            }
+
+            logMessage(row.trim());
+        }
+    }
+};
+
+static ChunkingBenchmarks chunkingBenchmarks;
@@ -0,0 +1,250 @@
+// GainStagesTests.cpp
+#include "TestHelpers.h"
+#include "../../Source/GainStages.h"
+
+// The timings in GainStages.h come from the benchmarks at the bottom, against the same work
+// done the way it was before the stages were fused: one pass over the buffer per step.
+namespace
+{
+    constexpr int blockSize = 512;
+    constexpr int numChannels = 2;
+
+    const ChannelLayout::Pair stereoPair {};
+
+    // A gain moving over the whole block, or standing still
+    ParameterRamps::Ramp makeRamp(float start, float end)
+    {
+        return { start, (end - start) / (float)blockSize, end };
+    }
+
+    //==============================================================================
+    // The steps as separate passes, the way the processor did them before the stages: the
+    // peak and the gain through juce::FloatVectorOperations, as AudioBuffer::getMagnitude()
+    // and applyGain() do, and the rest as loops for the compiler to vectorise. Like the
+    // stages, they only work the ramps out per sample while they're moving, and skip the
+    // width at 100%.
+    namespace Separate
+    {
+        template <typename SampleType>
+        Metering::ChannelReading measure(const SampleType* data, int numSamples)
+        {
+            Metering::ChannelReading reading;
+
+            const auto range = juce::FloatVectorOperations::findMinAndMax(data, numSamples);
+            reading.peak = (float)juce::jmax(-range.getStart(), range.getEnd());
+
+            for (int i = 0; i < numSamples; ++i)
+                reading.sumOfSquares += (float)(data[i] * data[i]);
+
+            for (int i = 0; i < numSamples; ++i)
+                reading.numClipped += std::abs(data[i]) >= SampleType(1) ? 1 : 0;
+
+            return reading;
+        }
+
+        template <typename SampleType>
+        void applyGain(SampleType* data, int numSamples, ParameterRamps::Ramp gain)
+        {
+            if (gain.isMoving())
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] *= (SampleType)gain.at((float)i);
+            else
+                juce::FloatVectorOperations::multiply(data, (SampleType)gain.end, numSamples);
+        }
+
+        template <typename SampleType>
+        void processPreStage(SampleType* const* channels, int numSamples, ParameterRamps::Ramp gain,
+                             ParameterRamps::Ramp width, Metering::ChannelReading* readings)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+                readings[channel] = measure(channels[channel], numSamples);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                applyGain(channels[channel], numSamples, gain);
+
+            if (!width.isMoving() && width.end == 1.0f)
+                return;
+
+            auto* left = channels[0];
+            auto* right = channels[1];
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto w = (SampleType)(width.isMoving() ? width.at((float)i) : width.end);
+                const auto mid = (left[i] + right[i]) * SampleType(0.5);
+                const auto side = (right[i] - left[i]) * SampleType(0.5) * w;
+                left[i] = mid - side;
+                right[i] = mid + side;
+            }
+        }
+
+        template <typename SampleType>
+        void processPostStage(SampleType* const* wet, const SampleType* const* dry, int numSamples,
+                              ParameterRamps::Ramp mix, ParameterRamps::Ramp gain, Metering::ChannelReading* readings)
+        {
+            if (mix.isMoving() || mix.end < 1.0f)
+            {
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    for (int i = 0; i < numSamples; ++i)
+                    {
+                        const auto m = (SampleType)(mix.isMoving() ? mix.at((float)i) : mix.end);
+                        wet[channel][i] = wet[channel][i] * m + dry[channel][i] * (SampleType(1) - m);
+                    }
+                }
+            }
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                applyGain(wet[channel], numSamples, gain);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                readings[channel] = measure(wet[channel], numSamples);
+        }
+    }
+
+    //==============================================================================
+    // A stereo block of noise, and a second one to be the dry signal
+    template <typename SampleType>
+    struct Block
+    {
+        Block()
+        {
+            juce::Random random(1);
+
+            for (auto* buffer : { &wet, &dry })
+            {
+                buffer->setSize(numChannels, blockSize);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    for (int i = 0; i < blockSize; ++i)
+                        buffer->setSample(channel, i, (SampleType)(random.nextFloat() * 2.0f - 1.0f));
+            }
+        }
+
+        SampleType* const* getWet() { return wet.getArrayOfWritePointers(); }
+        const SampleType* const* getDry() const { return dry.getArrayOfReadPointers(); }
+
+        juce::AudioBuffer<SampleType> wet, dry;
+    };
+}
+
+//==============================================================================
+class GainStagesTests : public juce::UnitTest
+{
+public:
+    GainStagesTests() : juce::UnitTest("Gain stages", "Nani") {}
+
+    void runTest() override
+    {
+        beginTest("The fused stages match the separate passes");
+        expectMatch<float>();
+        expectMatch<double>();
+    }
+
+private:
+    template <typename SampleType>
+    void expectMatch()
+    {
+        const juce::String type = std::is_same<SampleType, float>::value ? "float" : "double";
+
+        struct Settings { float gainStart, gainEnd, widthStart, widthEnd, mixStart, mixEnd; };
+
+        for (const auto& settings : { Settings { 1.3f, 1.3f, 1.0f, 1.0f, 1.0f, 1.0f },     // Width and mix at rest
+                                      Settings { 1.3f, 1.3f, 1.4f, 1.4f, 0.6f, 0.6f },     // Steady
+                                      Settings { 0.8f, 1.3f, 1.4f, 0.5f, 0.2f, 0.7f } })   // Everything moving
+        {
+            const auto gain = makeRamp(settings.gainStart, settings.gainEnd);
+            const auto width = makeRamp(settings.widthStart, settings.widthEnd);
+            const auto mix = makeRamp(settings.mixStart, settings.mixEnd);
+
+            Block<SampleType> fused, separate;
+            Metering::ChannelReading fusedIn[numChannels], fusedOut[numChannels], separateIn[numChannels], separateOut[numChannels];
+
+            GainStages::processPreStage(fused.getWet(), numChannels, blockSize, gain, width, &stereoPair, 1, fusedIn, numChannels);
+            GainStages::processPostStage(fused.getWet(), numChannels, fused.getDry(), numChannels, blockSize, mix, gain, fusedOut, numChannels);
+
+            Separate::processPreStage(separate.getWet(), blockSize, gain, width, separateIn);
+            Separate::processPostStage(separate.getWet(), separate.getDry(), blockSize, mix, gain, separateOut);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                double difference = 0.0;
+
+                for (int i = 0; i < blockSize; ++i)
+                    difference = juce::jmax(difference, (double)std::abs(fused.wet.getSample(channel, i) - separate.wet.getSample(channel, i)));
+
+                expectLessThan(difference, 1.0e-6, type);
+
+                for (auto [fusedReading, separateReading] : { std::make_pair(fusedIn[channel], separateIn[channel]),
+                                                              std::make_pair(fusedOut[channel], separateOut[channel]) })
+                {
+                    expectWithinAbsoluteError(fusedReading.peak, separateReading.peak, 1.0e-6f, type);
+                    expectWithinAbsoluteError(fusedReading.sumOfSquares, separateReading.sumOfSquares, separateReading.sumOfSquares * 1.0e-5f, type);
+                    expectEquals(fusedReading.numClipped, separateReading.numClipped, type);
+                }
+            }
+        }
+    }
+};
+
+static GainStagesTests gainStagesTests;
+
+//==============================================================================
+class GainStagesBenchmarks : public juce::UnitTest
+{
+public:
+    GainStagesBenchmarks() : juce::UnitTest("Gain stages", "Benchmarks") {}
+
+    void runTest() override
+    {
+        beginTest("Stereo block of 512, separate passes against fused");
+        logStages<float>("float", makeRamp(1.0f, 1.0f), makeRamp(1.3f, 1.3f), makeRamp(0.6f, 0.6f));
+
+        beginTest("Width at 100%");
+        logStages<float>("float", makeRamp(1.0f, 1.0f), makeRamp(1.0f, 1.0f), makeRamp(0.6f, 0.6f));
+
+        beginTest("Gain, width and mix all moving");
+        logStages<float>("float", makeRamp(1.0f, 1.1f), makeRamp(1.3f, 1.2f), makeRamp(0.6f, 0.5f));
+
+        beginTest("Double precision");
+        logStages<double>("double", makeRamp(1.0f, 1.0f), makeRamp(1.3f, 1.3f), makeRamp(0.6f, 0.6f));
+    }
+
+private:
+    template <typename SampleType>
+    void logStages(const juce::String& type, ParameterRamps::Ramp gain, ParameterRamps::Ramp width, ParameterRamps::Ramp mix)
+    {
+        // The stages work in place, so the same block goes round and round. Every other
+        // time round the gains and the width are turned upside down, which costs the same
+        // and keeps the level where it started.
+        Block<SampleType> block;
+        Metering::ChannelReading readings[numChannels];
+        constexpr int numRepeats = 1000;
+
+        auto invert = [](ParameterRamps::Ramp ramp) { return makeRamp(1.0f / ramp.start, 1.0f / ramp.end); };
+        const ParameterRamps::Ramp gains[] = { gain, invert(gain) };
+        const ParameterRamps::Ramp widths[] = { width, invert(width) };
+
+        auto time = [&](auto&& stage)
+        {
+            return TestHelpers::nanosecondsPer(numRepeats, [&]
+            {
+                for (int repeat = 0; repeat < numRepeats; ++repeat)
+                    stage(gains[repeat & 1], widths[repeat & 1]);
+            });
+        };
+
+        const double separatePre = time([&](auto g, auto w) { Separate::processPreStage(block.getWet(), blockSize, g, w, readings); });
+        const double fusedPre = time([&](auto g, auto w) { GainStages::processPreStage(block.getWet(), numChannels, blockSize, g, w,
+                                                                                       &stereoPair, 1, readings, numChannels); });
+
+        const double separatePost = time([&](auto g, auto) { Separate::processPostStage(block.getWet(), block.getDry(), blockSize, mix, g, readings); });
+        const double fusedPost = time([&](auto g, auto) { GainStages::processPostStage(block.getWet(), numChannels, block.getDry(), numChannels,
+                                                                                       blockSize, mix, g, readings, numChannels); });
+
+        logMessage(type + " pre-stage:  " + TestHelpers::formatNanoseconds(separatePre) + " -> " + TestHelpers::formatNanoseconds(fusedPre));
+        logMessage(type + " post-stage: " + TestHelpers::formatNanoseconds(separatePost) + " -> " + TestHelpers::formatNanoseconds(fusedPost));
+    }
+};
+
+static GainStagesBenchmarks gainStagesBenchmarks;
@@ -0,0 +1,294 @@
+// LimiterTests.cpp
+#include "TestHelpers.h"
+#include "../../Source/TruePeakLimiter.h"
+
+// The true-peak figures and the costs in TruePeakLimiter.h come from here.
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr float thresholdDecibels = -1.0f;
+
+    // Signals whose peaks fall between the samples, a quarter of a second of each. The sines
+    // fade in over 10 ms, since switching one on at full level is a click that reaches up to
+    // Nyquist.
+    enum class Signal { QuarterRateSine, HighSine, Bursts, ClippedNoise };
+
+    std::vector<float> makeSignal(Signal signal)
+    {
+        constexpr int length = (int)sampleRate / 4;
+        const double pi = juce::MathConstants<double>::pi;
+        std::vector<float> samples((size_t)length);
+        juce::Random random(3);
+
+        for (int i = 0; i < length; ++i)
+        {
+            double value = 0.0;
+
+            switch (signal)
+            {
+                // Sampled at 45 degrees, so every sample sits 3 dB under the crests: they're all
+                // under the threshold, and only the waveform between them is over
+                case Signal::QuarterRateSine:  value = 1.2 * std::sin(0.5 * pi * i + 0.25 * pi); break;
+                case Signal::HighSine:         value = 1.5 * std::sin(2.0 * pi * 11025.7 / sampleRate * i); break;
+                case Signal::Bursts:           value = (i % 4800 < 50 ? 3.0 : 0.3) * std::sin(2.0 * pi * 15000.0 / sampleRate * i + 0.3); break;
+                case Signal::ClippedNoise:     value = juce::jlimit(-1.0, 1.0, 3.0 * (random.nextDouble() * 2.0 - 1.0)); break;
+            }
+
+            if (signal == Signal::QuarterRateSine || signal == Signal::HighSine)
+                value *= 0.5 - 0.5 * std::cos(pi * juce::jmin(1.0, i / (0.01 * sampleRate)));
+
+            samples[(size_t)i] = (float)value;
+        }
+
+        return samples;
+    }
+
+    const char* getSignalName(Signal signal)
+    {
+        switch (signal)
+        {
+            case Signal::QuarterRateSine:  return "fs/4 sine at 45 degrees";
+            case Signal::HighSine:         return "11 kHz sine";
+            case Signal::Bursts:           return "15 kHz bursts";
+            default:                       return "clipped noise";
+        }
+    }
+
+    // Runs the signal through the limiter in stereo, the right channel 6 dB down, and hands
+    // back both channels with TruePeak::historyLength zeros in front of them
+    template <typename SampleType>
+    std::array<std::vector<float>, 2> limit(const std::vector<float>& signal, bool linked)
+    {
+        const int length = (int)signal.size();
+        std::vector<SampleType> left(signal.begin(), signal.end()), right((size_t)length);
+
+        for (int i = 0; i < length; ++i)
+            right[(size_t)i] = (SampleType)(0.5f * signal[(size_t)i]);
+
+        TruePeakLimiter<SampleType> limiter;
+        limiter.prepare(sampleRate, blockSize, 2);
+        limiter.setParameters(thresholdDecibels, 100.0f, linked);
+
+        for (int start = 0; start < length; start += blockSize)
+        {
+            SampleType* channels[] = { left.data() + start, right.data() + start };
+            limiter.process(channels, 2, juce::jmin(blockSize, length - start), true);
+        }
+
+        std::array<std::vector<float>, 2> outputs;
+
+        for (auto* channel : { &left, &right })
+        {
+            auto& output = outputs[channel == &left ? 0 : 1];
+            output.assign((size_t)TruePeak::historyLength, 0.0f);
+            output.insert(output.end(), channel->begin(), channel->end());
+        }
+
+        return outputs;
+    }
+
+    // The true peak as the limiter's own detector sees it: BS.1770's 4x interpolator
+    float measureBs1770(const std::vector<float>& output)
+    {
+        return TruePeak::findPeak(output.data() + TruePeak::historyLength, (int)output.size() - TruePeak::historyLength);
+    }
+
+    // A much finer reading, independent of the limiter: 32 points between every pair of
+    // samples from a Hann-windowed sinc 64 taps long
+    double measureReference(const std::vector<float>& output)
+    {
+        constexpr int oversampling = 32;
+        constexpr int halfLength = 32;
+        constexpr int numTaps = 2 * halfLength;
+        const double pi = juce::MathConstants<double>::pi;
+
+        static const auto coefficients = [&]
+        {
+            std::vector<double> table((size_t)(oversampling * numTaps));
+
+            for (int point = 0; point < oversampling; ++point)
+            {
+                for (int tap = 0; tap < numTaps; ++tap)
+                {
+                    const double distance = tap + 1 - halfLength - point / (double)oversampling;
+                    const double sinc = std::abs(distance) < 1.0e-9 ? 1.0 : std::sin(pi * distance) / (pi * distance);
+                    table[(size_t)(point * numTaps + tap)] = sinc * (0.5 + 0.5 * std::cos(pi * distance / halfLength));
+                }
+            }
+
+            return table;
+        }();
+
+        double peak = 0.0;
+
+        for (size_t i = halfLength - 1; i + halfLength < output.size(); ++i)
+        {
+            const float* taps = output.data() + i + 1 - halfLength;
+
+            for (int point = 0; point < oversampling; ++point)
+            {
+                const double* weights = coefficients.data() + point * numTaps;
+                double sum = 0.0;
+
+                for (int tap = 0; tap < numTaps; ++tap)
+                    sum += taps[tap] * weights[tap];
+
+                peak = juce::jmax(peak, std::abs(sum));
+            }
+        }
+
+        return peak;
+    }
+}
+
+//==============================================================================
+class LimiterTests : public juce::UnitTest
+{
+public:
+    LimiterTests() : juce::UnitTest("True-peak limiter", "Nani") {}
+
+    void runTest() override
+    {
+        // dBTP is defined by that meter, so this is the promise the limiter makes
+        beginTest("A BS.1770 true-peak meter never reads over the threshold");
+        for (auto signal : { Signal::QuarterRateSine, Signal::HighSine, Signal::Bursts, Signal::ClippedNoise })
+        {
+            expectUnderThresholdOnMeter<float>(signal);
+            expectUnderThresholdOnMeter<double>(signal);
+        }
+
+        // Between the meter's four points as well. Noise right up to Nyquist can still go
+        // over on this reading; the header says by how much
+        beginTest("The reconstructed peaks of high sines stay under the threshold");
+        for (auto signal : { Signal::QuarterRateSine, Signal::HighSine })
+        {
+            expectUnderThresholdOnReference<float>(signal);
+            expectUnderThresholdOnReference<double>(signal);
+        }
+
+        beginTest("Switched off, the audio is only delayed by the latency");
+        expectOnlyDelayed();
+    }
+
+private:
+    // A rounding error's worth over, from the gain being applied in the sample type
+    static constexpr double tolerance = 1.0e-5;
+
+    static double getThreshold() { return juce::Decibels::decibelsToGain((double)thresholdDecibels); }
+
+    template <typename SampleType>
+    void expectUnderThresholdOnMeter(Signal signal)
+    {
+        const auto input = makeSignal(signal);
+
+        for (bool linked : { true, false })
+            for (const auto& output : limit<SampleType>(input, linked))
+                expectLessOrEqual((double)measureBs1770(output), getThreshold() + tolerance, describe<SampleType>(signal, linked));
+    }
+
+    template <typename SampleType>
+    void expectUnderThresholdOnReference(Signal signal)
+    {
+        const auto input = makeSignal(signal);
+
+        // Make sure the signal is one the limiter has to catch between the samples
+        if (signal == Signal::QuarterRateSine)
+        {
+            expectLessThan((double)juce::FloatVectorOperations::findMaximum(input.data(), (int)input.size()), getThreshold());
+            expectGreaterThan(measureReference(input), 1.0);
+        }
+
+        for (bool linked : { true, false })
+            for (const auto& output : limit<SampleType>(input, linked))
+                expectLessOrEqual(measureReference(output), getThreshold(), describe<SampleType>(signal, linked));
+    }
+
+    void expectOnlyDelayed()
+    {
+        constexpr int length = 1000;
+        TruePeakLimiter<float> limiter;
+        limiter.prepare(sampleRate, 64, 1);
+        limiter.setParameters(thresholdDecibels, 100.0f, true);
+
+        std::vector<float> samples((size_t)length, 0.0f);
+        samples[10] = 4.0f;
+
+        for (int start = 0; start < length; start += 64)
+        {
+            float* channels[] = { samples.data() + start };
+            limiter.process(channels, 1, juce::jmin(64, length - start), false);
+        }
+
+        for (int i = 0; i < length; ++i)
+            expectEquals(samples[(size_t)i], i == 10 + limiter.getLatencySamples() ? 4.0f : 0.0f);
+    }
+
+    template <typename SampleType>
+    static juce::String describe(Signal signal, bool linked)
+    {
+        return juce::String(getSignalName(signal)) + (std::is_same<SampleType, float>::value ? ", float" : ", double")
+               + (linked ? ", linked" : ", unlinked");
+    }
+};
+
+static LimiterTests limiterTests;
+
+//==============================================================================
+class LimiterBenchmarks : public juce::UnitTest
+{
+public:
+    LimiterBenchmarks() : juce::UnitTest("True-peak limiter", "Benchmarks") {}
+
+    void runTest() override
+    {
+        beginTest("Peaks after limiting to -1 dB");
+        for (auto signal : { Signal::QuarterRateSine, Signal::HighSine, Signal::Bursts, Signal::ClippedNoise })
+        {
+            const auto output = limit<float>(makeSignal(signal), true)[0];
+
+            logMessage(juce::String(getSignalName(signal)).paddedRight(' ', 26)
+                       + "BS.1770 " + juce::String(juce::Decibels::gainToDecibels(measureBs1770(output)), 2)
+                       + " dBTP, 32x reference " + juce::String(juce::Decibels::gainToDecibels(measureReference(output)), 2) + " dBTP");
+        }
+
+        beginTest("Cost per sample and channel");
+        logCost<float>(2, true, true, "stereo linked");
+        logCost<float>(2, false, true, "stereo unlinked");
+        logCost<float>(1, true, true, "mono");
+        logCost<double>(2, true, true, "stereo linked, double");
+        logCost<float>(2, true, false, "switched off");
+    }
+
+private:
+    template <typename SampleType>
+    void logCost(int numChannels, bool linked, bool limiting, const char* name)
+    {
+        TruePeakLimiter<SampleType> limiter;
+        limiter.prepare(sampleRate, blockSize, numChannels);
+        limiter.setParameters(thresholdDecibels, 100.0f, linked);
+
+        juce::Random random(1);
+        std::vector<SampleType> samples((size_t)(numChannels * blockSize));
+
+        for (auto& sample : samples)
+            sample = (SampleType)(random.nextFloat() * 4.0f - 2.0f);
+
+        std::vector<SampleType*> channels;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            channels.push_back(samples.data() + channel * blockSize);
+
+        // The limiter works in place, so the signal is limited again on every pass; the
+        // detection and the envelope cost the same whatever the level
+        const double nanoseconds = TestHelpers::nanosecondsPer(blockSize * numChannels * 100.0, [&]
+        {
+            for (int repeat = 0; repeat < 100; ++repeat)
+                limiter.process(channels.data(), numChannels, blockSize, limiting);
+        });
+
+        logMessage(juce::String(name).paddedRight(' ', 24) + TestHelpers::formatNanoseconds(nanoseconds));
+    }
+};
+
+static LimiterBenchmarks limiterBenchmarks;
@@ -0,0 +1,47 @@
+// Main.cpp
+#include <JuceHeader.h>
+
+// Runs the plugin's unit tests. The benchmarks behind the figures quoted in the headers are
+// in their own category and only run when asked for, since they take a while and only mean
+// something in a Release build on an otherwise idle machine:
+//   NaniTests                  every test except the benchmarks
+//   NaniTests --benchmarks     just the benchmarks
+//   NaniTests <category>       one category
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+
+    for (int i = 1; i < argc; ++i)
+        args.add(argv[i]);
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+
+    if (args.contains("--benchmarks"))
+    {
+        runner.runTestsInCategory("Benchmarks");
+    }
+    else if (args.size() > 0)
+    {
+        runner.runTestsInCategory(args[0]);
+    }
+    else
+    {
+        juce::Array<juce::UnitTest*> tests;
+
+        for (auto* test : juce::UnitTest::getAllTests())
+            if (test->getCategory() != "Benchmarks")
+                tests.add(test);
+
+        runner.runTests(tests);
+    }
+
+    int failures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        failures += runner.getResult(i)->failures;
+
+    return failures > 0 ? 1 : 0;
+}
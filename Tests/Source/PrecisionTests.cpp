@@ -0,0 +1,219 @@
+// PrecisionTests.cpp
+#include "TestHelpers.h"
+#include "../../Source/Multiband.h"
+#include "../../Source/Decimator.h"
+
+// The float against double shaper figures in WaveshaperKernels.h come from the benchmarks at
+// the bottom. The gain stages and the limiter time their double paths in their own files.
+namespace
+{
+    constexpr double baseSampleRate = 44100.0;
+    constexpr int blockSize = 512;
+
+    template <typename SampleType>
+    const char* getTypeName() { return std::is_same<SampleType, float>::value ? "float" : "double"; }
+
+    template <typename SampleType>
+    void fill(juce::AudioBuffer<SampleType>& buffer)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* data = buffer.getWritePointer(channel);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                data[i] = (SampleType)(0.7 * std::sin(i * 0.003 + channel) + 0.2 * std::sin(i * 0.0171));
+        }
+    }
+}
+
+//==============================================================================
+class PrecisionTests : public juce::UnitTest
+{
+public:
+    PrecisionTests() : juce::UnitTest("Double precision", "Nani") {}
+
+    void runTest() override
+    {
+        // The same chain in both precisions, so the two can only part by float's rounding
+        beginTest("The double chain follows the float one");
+        for (auto type : { SoftClip, HardClip, Foldback, BitGlitch })
+            for (int rateIndex : { 0, 2 })
+                expectChainsAgree(type, rateIndex);
+    }
+
+private:
+    void expectChainsAgree(DistortionType type, int rateIndex)
+    {
+        constexpr int numChannels = 2;
+        const int numSamples = blockSize << rateIndex;
+
+        ParameterSnapshot params;
+        params.distortionType = type;
+        params.drive = 0.5f;
+        params.filterCutoff = 5000.0f;
+
+        TestHelpers::ChainRig<float> floatRig(baseSampleRate, blockSize, numChannels);
+        TestHelpers::ChainRig<double> doubleRig(baseSampleRate, blockSize, numChannels);
+        juce::AudioBuffer<float> floatBuffer(numChannels, numSamples);
+        juce::AudioBuffer<double> doubleBuffer(numChannels, numSamples);
+        double difference = 0.0;
+
+        for (int block = 0; block < 3; ++block)
+        {
+            fill(floatBuffer);
+            fill(doubleBuffer);
+            floatRig.process(floatBuffer, rateIndex, params);
+            doubleRig.process(doubleBuffer, rateIndex, params);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                for (int i = 0; i < numSamples; ++i)
+                    difference = juce::jmax(difference, std::abs((double)floatBuffer.getSample(channel, i) - doubleBuffer.getSample(channel, i)));
+        }
+
+        // A few float ulps at full scale. BitGlitch flips the bits of the sample rounded to
+        // float in both, so it's no further out than the rest.
+        expectLessThan(difference, 1.0e-5,
+                       "type " + juce::String((int)type) + ", rate index " + juce::String(rateIndex));
+    }
+};
+
+static PrecisionTests precisionTests;
+
+//==============================================================================
+class PrecisionBenchmarks : public juce::UnitTest
+{
+public:
+    PrecisionBenchmarks() : juce::UnitTest("Double precision", "Benchmarks") {}
+
+    void runTest() override
+    {
+        beginTest("Shapers, per sample: float vectorised, double reference");
+        logShapers();
+
+        beginTest("Four-band split, per sample");
+        logSplit<float>();
+        logSplit<double>();
+
+        beginTest("Band-limited fractional decimator, per sample");
+        logDecimator<float>();
+        logDecimator<double>();
+
+        beginTest("Default chain, per sample and channel");
+        for (int rateIndex : { 0, 4 })
+        {
+            logChain<float>(rateIndex);
+            logChain<double>(rateIndex);
+        }
+    }
+
+private:
+    template <typename SampleType>
+    static std::vector<SampleType> makeInput(int numSamples)
+    {
+        std::vector<SampleType> input((size_t)numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+            input[(size_t)i] = (SampleType)(0.8 * std::sin(i * 0.05));
+
+        return input;
+    }
+
+    // Each run starts from a fresh copy of the input, which both precisions pay for
+    template <typename SampleType>
+    static double timeShaper(DistortionType type)
+    {
+        const auto shaper = WaveshaperKernels::getBlockFunction<SampleType>(type, WaveshaperKernels::getBestImplementation());
+        const auto input = makeInput<SampleType>(blockSize);
+        std::vector<SampleType> data((size_t)blockSize);
+        constexpr int numRepeats = 1000;
+
+        return TestHelpers::nanosecondsPer((double)blockSize * numRepeats, [&]
+        {
+            for (int repeat = 0; repeat < numRepeats; ++repeat)
+            {
+                std::copy(input.begin(), input.end(), data.begin());
+                shaper(data.data(), blockSize, 0.5f);
+            }
+        });
+    }
+
+    void logShapers()
+    {
+        const char* names[] = { "SoftClip", "HardClip", "Foldback", "BitGlitch" };
+
+        for (auto type : { SoftClip, HardClip, Foldback, BitGlitch })
+            logMessage(juce::String(names[type]).paddedRight(' ', 12) + TestHelpers::formatNanoseconds(timeShaper<float>(type)).paddedRight(' ', 10)
+                       + TestHelpers::formatNanoseconds(timeShaper<double>(type)));
+    }
+
+    template <typename SampleType>
+    void logSplit()
+    {
+        constexpr int numSamples = 256;
+        Multiband::Crossover<SampleType> crossover;
+        crossover.prepare(1);
+        crossover.setParameters(baseSampleRate, 4, { 150.0f, 1000.0f, 5000.0f });
+
+        const auto input = makeInput<SampleType>(numSamples);
+        std::vector<SampleType> bands((size_t)(4 * numSamples));
+        SampleType* bandPointers[] = { bands.data(), bands.data() + numSamples, bands.data() + 2 * numSamples, bands.data() + 3 * numSamples };
+        constexpr int numRepeats = 1000;
+
+        const double nanoseconds = TestHelpers::nanosecondsPer((double)numSamples * numRepeats, [&]
+        {
+            for (int repeat = 0; repeat < numRepeats; ++repeat)
+                crossover.split(0, input.data(), bandPointers, numSamples);
+        });
+
+        logMessage(juce::String(getTypeName<SampleType>()).paddedRight(' ', 8) + TestHelpers::formatNanoseconds(nanoseconds));
+    }
+
+    template <typename SampleType>
+    void logDecimator()
+    {
+        Decimator<SampleType> decimator;
+        decimator.prepare(1);
+
+        // Held samples are written back over the input, so it's copied in every time
+        const auto input = makeInput<SampleType>(blockSize);
+        std::vector<SampleType> data((size_t)blockSize);
+        constexpr int numRepeats = 1000;
+
+        const double nanoseconds = TestHelpers::nanosecondsPer((double)blockSize * numRepeats, [&]
+        {
+            for (int repeat = 0; repeat < numRepeats; ++repeat)
+            {
+                std::copy(input.begin(), input.end(), data.begin());
+                decimator.process(0, data.data(), blockSize, 3.5f, { true, true });
+            }
+        });
+
+        logMessage(juce::String(getTypeName<SampleType>()).paddedRight(' ', 8) + TestHelpers::formatNanoseconds(nanoseconds));
+    }
+
+    template <typename SampleType>
+    void logChain(int rateIndex)
+    {
+        constexpr int numChannels = 2;
+        const int numSamples = blockSize << rateIndex;
+
+        ParameterSnapshot params;
+        params.drive = 0.5f;
+        params.filterCutoff = 5000.0f;
+
+        TestHelpers::ChainRig<SampleType> rig(baseSampleRate, blockSize, numChannels);
+        juce::AudioBuffer<SampleType> input(numChannels, numSamples), buffer(numChannels, numSamples);
+        fill(input);
+
+        const double nanoseconds = TestHelpers::nanosecondsPer((double)numSamples * numChannels, [&]
+        {
+            buffer.makeCopyOf(input, true);
+            rig.process(buffer, rateIndex, params);
+        });
+
+        logMessage(juce::String(getTypeName<SampleType>()).paddedRight(' ', 8) + juce::String(1 << rateIndex) + "x  "
+                   + TestHelpers::formatNanoseconds(nanoseconds));
+    }
+};
+
+static PrecisionBenchmarks precisionBenchmarks;
@@ -0,0 +1,150 @@
+// TestHelpers.h
+#pragma once
+
+#include <JuceHeader.h>
+#include <complex>
+#include "../../Source/ProcessingChain.h"
+
+// Shared by the tests and the benchmarks: timing, a spectrum measurement fine enough for the
+// aliasing figures, and a rig that runs the distortion chain on its own.
+namespace TestHelpers
+{
+    // The fastest of several runs of the function, in nanoseconds per item. Taking the best
+    // run rather than the mean keeps the figure clear of interruptions.
+    template <typename Function>
+    double nanosecondsPer(double itemsPerRun, Function&& run, int numRuns = 20)
+    {
+        run(); // Warm the caches up first
+
+        double best = std::numeric_limits<double>::max();
+
+        for (int i = 0; i < numRuns; ++i)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            run();
+            const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+            best = juce::jmin(best, seconds * 1.0e9 / itemsPerRun);
+        }
+
+        return best;
+    }
+
+    inline juce::String formatNanoseconds(double nanoseconds)
+    {
+        return juce::String(nanoseconds, nanoseconds < 10.0 ? 2 : 1) + " ns";
+    }
+
+    //==============================================================================
+    // In-place radix-2 FFT in double. The aliasing figures go far below what a float FFT
+    // can resolve, so juce::dsp::FFT won't do for them.
+    inline void fft(std::vector<std::complex<double>>& data)
+    {
+        const size_t n = data.size();
+        jassert(juce::isPowerOfTwo((int)n));
+
+        for (size_t i = 1, j = 0; i < n; ++i)
+        {
+            size_t bit = n >> 1;
+
+            for (; (j & bit) != 0; bit >>= 1)
+                j ^= bit;
+
+            j ^= bit;
+
+            if (i < j)
+                std::swap(data[i], data[j]);
+        }
+
+        for (size_t length = 2; length <= n; length <<= 1)
+        {
+            const double angle = -2.0 * juce::MathConstants<double>::pi / (double)length;
+            const std::complex<double> rotation { std::cos(angle), std::sin(angle) };
+
+            for (size_t start = 0; start < n; start += length)
+            {
+                std::complex<double> w { 1.0, 0.0 };
+
+                for (size_t k = 0; k < length / 2; ++k)
+                {
+                    const auto a = data[start + k];
+                    const auto b = data[start + k + length / 2] * w;
+                    data[start + k] = a + b;
+                    data[start + k + length / 2] = a - b;
+                    w *= rotation;
+                }
+            }
+        }
+    }
+
+    // The signal is a sine at bin fundamentalBin, run through something nonlinear at
+    // oversamplingFactor times the base rate, and holds a whole number of its periods.
+    // Returns the power of everything below the base rate's Nyquist that isn't the
+    // fundamental or one of its harmonics, relative to the fundamental, in dB. Dropping
+    // everything above the base Nyquist stands in for ideal decimation filters.
+    template <typename SampleType>
+    double measureAliasing(const std::vector<SampleType>& signal, int fundamentalBin, int oversamplingFactor)
+    {
+        std::vector<std::complex<double>> spectrum(signal.begin(), signal.end());
+        fft(spectrum);
+
+        const int baseNyquistBin = (int)signal.size() / (2 * oversamplingFactor);
+        const double fundamental = std::norm(spectrum[(size_t)fundamentalBin]);
+        double other = 0.0;
+
+        for (int bin = 1; bin < baseNyquistBin; ++bin)
+            if (bin % fundamentalBin != 0)
+                other += std::norm(spectrum[(size_t)bin]);
+
+        return 10.0 * std::log10(juce::jmax(other, 1.0e-300) / fundamental);
+    }
+
+    // A full-scale sine at bin fundamentalBin of a signal of the given length
+    template <typename SampleType>
+    std::vector<SampleType> makeSine(int length, int fundamentalBin)
+    {
+        std::vector<SampleType> signal((size_t)length);
+
+        for (int i = 0; i < length; ++i)
+            signal[(size_t)i] = (SampleType)std::sin(2.0 * juce::MathConstants<double>::pi * fundamentalBin * (double)i / length);
+
+        return signal;
+    }
+
+    //==============================================================================
+    // Runs the distortion chain on its own, the way processAudio() does, at the processing
+    // rate of an oversampling step (rateIndex 0 is 1x, 4 is 16x). The oversampling filters
+    // aren't part of it.
+    template <typename SampleType>
+    class ChainRig
+    {
+    public:
+        ChainRig(double sampleRateToUse, int maxBlockSize, int numChannels)
+            : baseSampleRate(sampleRateToUse)
+        {
+            state.prepare(baseSampleRate, maxBlockSize, numChannels);
+            bandBuffer.setSize(numChannels * Multiband::maxBands, Multiband::chunkSize);
+        }
+
+        void process(juce::AudioBuffer<SampleType>& buffer, int rateIndex, const ParameterSnapshot& params,
+                     int tileSize = ProcessingChain::defaultTileSize)
+        {
+            auto& filter = state.filters.getFilter(rateIndex);
+            filter.setParameters(params.filterType, params.filterCutoff, params.filterResonance);
+            state.crossover.setParameters(baseSampleRate * (1 << rateIndex), params.numBands, params.crossoverFrequencies);
+
+            ProcessingChain::Context<SampleType> context { filter, state.decimator, state.adaa,
+                                                           WaveshaperKernels::getBestImplementation(),
+                                                           state.crossover, bandBuffer };
+            juce::dsp::AudioBlock<SampleType> block(buffer);
+
+            filter.beginBlock();
+            ProcessingChain::processTiled(ProcessingChain::select<SampleType>(params), block, 0, params, context, tileSize);
+            filter.endBlock();
+        }
+
+    private:
+        double baseSampleRate;
+        ProcessingChain::State<SampleType> state;
+        juce::AudioBuffer<SampleType> bandBuffer;
+    };
+}
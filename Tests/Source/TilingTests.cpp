@@ -0,0 +1,151 @@
+// TilingTests.cpp
+#include "TestHelpers.h"
+
+// The tiling figures at the top of ProcessingChain.h come from the benchmarks at the bottom.
+namespace
+{
+    constexpr double baseSampleRate = 44100.0;
+    constexpr int maxHostBlockSize = 2048;
+    constexpr int rateIndex = 4;    // 16x, where the blocks are biggest
+
+    struct Configuration
+    {
+        const char* name;
+        ParameterSnapshot params;
+    };
+
+    // The default chain, and the ones that add the most stages or state
+    std::vector<Configuration> getConfigurations()
+    {
+        ParameterSnapshot standard;
+        standard.filterCutoff = 5000.0f;
+        standard.drive = 0.5f;
+
+        auto crushed = standard;
+        crushed.bitDepth = 8;
+        crushed.sampleRateReduction = 0.17f;
+        crushed.decimatorBandLimited = true;
+        crushed.decimatorFractional = true;
+        crushed.filterRouting = Pre;
+
+        auto adaa = standard;
+        adaa.antiAliasing = Adaa::FirstOrder;
+        adaa.distortionType = HardClip;
+
+        auto multiband = standard;
+        multiband.numBands = 4;
+
+        return { { "default", standard }, { "crush + decimate", crushed }, { "ADAA1 hard clip", adaa }, { "four bands", multiband } };
+    }
+
+    template <typename SampleType>
+    void fill(juce::AudioBuffer<SampleType>& buffer)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* data = buffer.getWritePointer(channel);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                data[i] = (SampleType)(0.7 * std::sin(i * 0.003 + channel) + 0.2 * std::sin(i * 0.0171));
+        }
+    }
+}
+
+//==============================================================================
+class TilingTests : public juce::UnitTest
+{
+public:
+    TilingTests() : juce::UnitTest("Tiling", "Nani") {}
+
+    void runTest() override
+    {
+        // Every stage carries its state from sample to sample and nothing looks ahead
+        beginTest("Tiles come out bit-identical to the whole block");
+        for (const auto& configuration : getConfigurations())
+        {
+            expectIdentical<float>(configuration);
+            expectIdentical<double>(configuration);
+        }
+    }
+
+private:
+    template <typename SampleType>
+    void expectIdentical(const Configuration& configuration)
+    {
+        constexpr int numChannels = 2;
+        constexpr int numSamples = maxHostBlockSize << rateIndex;
+
+        for (int tileSize : { 64, 128, 256, 1024 })
+        {
+            TestHelpers::ChainRig<SampleType> whole(baseSampleRate, maxHostBlockSize, numChannels);
+            TestHelpers::ChainRig<SampleType> tiled(baseSampleRate, maxHostBlockSize, numChannels);
+            juce::AudioBuffer<SampleType> wholeBuffer(numChannels, numSamples), tiledBuffer(numChannels, numSamples);
+            bool identical = true;
+
+            // A few blocks in a row, so the state carried over between them is checked too
+            for (int block = 0; block < 3; ++block)
+            {
+                fill(wholeBuffer);
+                fill(tiledBuffer);
+                whole.process(wholeBuffer, rateIndex, configuration.params, 0);
+                tiled.process(tiledBuffer, rateIndex, configuration.params, tileSize);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    identical = identical && std::memcmp(wholeBuffer.getReadPointer(channel), tiledBuffer.getReadPointer(channel),
+                                                         (size_t)numSamples * sizeof(SampleType)) == 0;
+            }
+
+            expect(identical, juce::String(configuration.name) + ", tiles of " + juce::String(tileSize)
+                                  + (std::is_same<SampleType, float>::value ? ", float" : ", double"));
+        }
+    }
+};
+
+static TilingTests tilingTests;
+
+//==============================================================================
+class TilingBenchmarks : public juce::UnitTest
+{
+public:
+    TilingBenchmarks() : juce::UnitTest("Tiling", "Benchmarks") {}
+
+    void runTest() override
+    {
+        beginTest("Chain at 16x, per sample and channel, by tile size");
+        logMessage("                                      none      64        256       1024");
+
+        for (const auto& configuration : getConfigurations())
+            for (int numChannels : { 2, 16 })
+                for (int hostBlockSize : { 256, maxHostBlockSize })
+                    logRow(configuration, numChannels, hostBlockSize);
+    }
+
+private:
+    void logRow(const Configuration& configuration, int numChannels, int hostBlockSize)
+    {
+        const int numSamples = hostBlockSize << rateIndex;
+        juce::AudioBuffer<float> input(numChannels, numSamples), buffer(numChannels, numSamples);
+        fill(input);
+
+        juce::String row = (juce::String(configuration.name) + ", " + juce::String(numChannels) + " ch, "
+                            + juce::String(hostBlockSize)).paddedRight(' ', 38);
+
+        for (int tileSize : { 0, 64, 256, 1024 })
+        {
+            TestHelpers::ChainRig<float> rig(baseSampleRate, maxHostBlockSize, numChannels);
+
+            // The input is copied in first every time, the way the oversampler hands it over
+            const double nanoseconds = TestHelpers::nanosecondsPer((double)numSamples * numChannels, [&]
+            {
+                buffer.makeCopyOf(input, true);
+                rig.process(buffer, rateIndex, configuration.params, tileSize);
+            }, 10);
+
+            row << TestHelpers::formatNanoseconds(nanoseconds).paddedRight(' ', 10);
+        }
+
+        logMessage(row);
+    }
+};
+
+static TilingBenchmarks tilingBenchmarks;